@@ -1,6 +1,6 @@
 #! /usr/bin/perl
 
-$release_files = 'source/utf8.h  source/utf8/core.h source/utf8/checked.h source/utf8/unchecked.h doc/utf8cpp.html doc/ReleaseNotes';
+$release_files = 'source/utf8.h  source/utf8/core.h source/utf8/checked.h source/utf8/unchecked.h source/utf8/simd.h source/utf8/cpu.h source/utf8/cpp11.h source/utf8/stream.h source/utf8/parallel.h source/utf8/file.h source/utf8/instrument.h source/utf8/index.h source/utf8/view.h source/utf8/block.h doc/utf8cpp.html doc/ReleaseNotes';
 
 # First get the latest version
 `svn update`;
@@ -35,12 +35,12 @@ int main(int argc, char** argv)
         int length = utf8::distance(line.begin(), end_it);
         cout << "Length of line " << line_count << " is " << length <<  "\n";
 
-        // Convert it to utf-16
-        vector<unsigned short> utf16line;
-        utf8::utf8to16(line.begin(), end_it, back_inserter(utf16line));
+        // Convert it to utf-16, into a vector of just the right size
+        vector<unsigned short> utf16line(utf8::utf8to16_length(line.begin(), end_it));
+        utf8::utf8to16(line.begin(), end_it, utf16line.begin());
         // And back to utf-8;
-        string utf8line; 
-        utf8::utf16to8(utf16line.begin(), utf16line.end(), back_inserter(utf8line));
+        string utf8line(utf8::utf16to8_length(utf16line.begin(), utf16line.end()), ' ');
+        utf8::utf16to8(utf16line.begin(), utf16line.end(), utf8line.begin());
         // Confirm that the conversion went OK:
         if (utf8line != string(line.begin(), end_it))
             cout << "Error in UTF-16 conversion at line: " << line_count << "\n";        
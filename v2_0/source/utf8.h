@@ -30,5 +30,17 @@ DEALINGS IN THE SOFTWARE.
 
 #include "utf8/checked.h"
 #include "utf8/unchecked.h"
+#include "utf8/stream.h"
+#include "utf8/index.h"
+#include "utf8/view.h"
+#include "utf8/block.h"
+
+// Conversions to and from std::u16string and std::u32string need C++11.
+// So do the parallel versions of the functions, which are in a header of
+// their own, utf8/parallel.h, as they need threads.
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#define UTF8_CPP_CPP11
+#include "utf8/cpp11.h"
+#endif
 
 #endif // header guard
@@ -0,0 +1,188 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_BLOCK_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_BLOCK_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+#include "checked.h"
+#include <stdexcept>
+#include <vector>
+
+namespace utf8
+{
+    // Decodes UTF-8 into blocks of code points, a block at a time, so that
+    // the consumer can work on whole blocks (with SIMD, say) rather than on
+    // one code point after another. Each block is decoded by
+    // utf8to32_bounded, which takes the bulk paths for raw pointers; with
+    // the default size of 256 code points, a block and its offsets stay in
+    // the L1 cache.
+    template <typename octet_iterator>
+    class block_decoder {
+        octet_iterator it, last;
+        std::vector<uint32_t> own_code_points;
+        std::vector<std::size_t> own_offsets;
+        uint32_t* code_points;
+        std::size_t* octet_offsets;
+        std::size_t capacity;
+        std::size_t count;      // in the current block
+        std::size_t consumed;   // octets before it
+
+        block_decoder (const block_decoder&);
+        block_decoder& operator = (const block_decoder&);
+      public:
+        static const std::size_t default_block_size = 256;
+
+        /// A decoder with buffers of its own, of block_size code points.
+        /// With offsets set it also records the octet offset of each code
+        /// point in [first, last).
+        block_decoder (octet_iterator first, octet_iterator last, std::size_t block_size = default_block_size, bool offsets = false) :
+                it(first), last(last), own_code_points(block_size ? block_size : 1), own_offsets(offsets ? own_code_points.size() : 0),
+                code_points(&own_code_points[0]), octet_offsets(offsets ? &own_offsets[0] : 0),
+                capacity(own_code_points.size()), count(0), consumed(0) {}
+
+        /// A decoder that writes blocks of up to block_size code points, which
+        /// must not be zero, to the given buffer, and their offsets to
+        /// offsets unless it is null
+        block_decoder (octet_iterator first, octet_iterator last, uint32_t* buffer, std::size_t block_size, std::size_t* offsets = 0) :
+                it(first), last(last), code_points(buffer), octet_offsets(offsets),
+                capacity(block_size), count(0), consumed(0)
+        {
+            // A block of no code points would never get past the first one
+            if (block_size == 0)
+                throw std::invalid_argument("Invalid block size");
+        }
+
+        /// Decodes the next block, and returns false when there is none.
+        /// The input is checked as utf8to32 checks it: an invalid sequence
+        /// throws once the blocks before it have been returned.
+        bool next ()
+        {
+            count = 0;
+            if (it == last)
+                return false;
+
+            conversion_result<octet_iterator, uint32_t*> result = utf8::utf8to32_bounded(it, last, code_points, capacity);
+            if (result.written == 0 && result.status != conversion_output_full) {
+                // next throws for the sequence that the conversion stopped at
+                utf8::next(result.in, last);
+            }
+            if (octet_offsets) {
+                std::size_t offset = consumed;
+                for (std::size_t i = 0; i < result.written; ++i) {
+                    octet_offsets[i] = offset;
+                    const std::size_t length = static_cast<std::size_t>(utf8::internal::sequence_length(it));
+                    std::advance(it, length);
+                    offset += length;
+                }
+            }
+            it = result.in;
+            count = result.written;
+            consumed += result.consumed;
+            return true;
+        }
+
+        /// The code points of the current block
+        const uint32_t* begin () const { return code_points; }
+        const uint32_t* end () const { return code_points + count; }
+        std::size_t size () const { return count; }
+
+        /// The octet offsets of the code points of the current block, from
+        /// the start of the input; null unless they were asked for
+        const std::size_t* offsets () const { return octet_offsets; }
+
+        /// Where the next block starts
+        octet_iterator position () const { return it; }
+
+        /// A decoded block: its code points, and their offsets if they
+        /// were asked for
+        struct block {
+            const uint32_t* code_points;
+            std::size_t size;
+            const std::size_t* offsets;
+
+            const uint32_t* begin () const { return code_points; }
+            const uint32_t* end () const { return code_points + size; }
+        };
+
+        /// An input iterator over the blocks, which calls next on the
+        /// decoder as it is incremented. The blocks live in the buffers of
+        /// the decoder, so each one is overwritten by the one after it.
+        class block_iterator {
+            block_decoder* decoder; // null past the last block
+            block current;
+
+            void read ()
+            {
+                if (decoder->next()) {
+                    current.code_points = decoder->begin();
+                    current.size = decoder->size();
+                    current.offsets = decoder->offsets();
+                }
+                else
+                    decoder = 0;
+            }
+          public:
+            typedef std::input_iterator_tag iterator_category;
+            typedef block value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const block* pointer;
+            typedef const block& reference;
+
+            block_iterator () : decoder(0) {}
+            explicit block_iterator (block_decoder& decoder) : decoder(&decoder) { read(); }
+            const block& operator * () const { return current; }
+            const block* operator -> () const { return &current; }
+            bool operator == (const block_iterator& rhs) const { return decoder == rhs.decoder; }
+            bool operator != (const block_iterator& rhs) const { return decoder != rhs.decoder; }
+            block_iterator& operator ++ ()
+            {
+                read();
+                return *this;
+            }
+            block_iterator operator ++ (int)
+            {
+                block_iterator temp = *this;
+                read();
+                return temp;
+            }
+        };
+
+        /// The blocks still to be decoded, for a range-based for. Its begin
+        /// decodes the first of them, so it is meant to be called once.
+        class block_range {
+            block_decoder* decoder;
+          public:
+            explicit block_range (block_decoder& decoder) : decoder(&decoder) {}
+            block_iterator begin () const { return block_iterator(*decoder); }
+            block_iterator end () const { return block_iterator(); }
+        };
+
+        block_range blocks () { return block_range(*this); }
+    };
+} // namespace utf8
+
+#endif // header guard
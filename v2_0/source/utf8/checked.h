@@ -72,9 +72,12 @@ namespace utf8
     template <typename octet_iterator>
     octet_iterator append(uint32_t cp, octet_iterator result)
     {
-        if (!utf8::internal::is_code_point_valid(cp))
+        if (!utf8::internal::is_code_point_valid(cp)) {
+            utf8::internal::count_error(internal::INVALID_CODE_POINT);
             throw invalid_code_point(cp);
+        }
 
+        utf8::internal::count_encoded(cp);
         if (cp < 0x80)                        // one octet
             *(result++) = static_cast<uint8_t>(cp);
         else if (cp < 0x800) {                // two octets
@@ -99,6 +102,13 @@ namespace utf8
     output_iterator replace_invalid(octet_iterator start, octet_iterator end, output_iterator out, uint32_t replacement)
     {
         while (start != end) {
+            // Copy ASCII runs as they are
+            utf8::internal::copy_ascii(start, end, out, true);
+            for (octet_iterator ascii_end = utf8::internal::skip_ascii(start, end, true); start != ascii_end; ++start)
+                *out++ = *start;
+            if (start == end)
+                break;
+
             octet_iterator sequence_start = start;
             internal::utf_error err_code = utf8::internal::validate_next(start, end);
             switch (err_code) {
@@ -109,12 +119,14 @@ namespace utf8
                 case internal::NOT_ENOUGH_ROOM:
                     throw not_enough_room();
                 case internal::INVALID_LEAD:
+                    utf8::internal::count_replacement();
                     out = utf8::append (replacement, out);
                     ++start;
                     break;
                 case internal::INCOMPLETE_SEQUENCE:
                 case internal::OVERLONG_SEQUENCE:
                 case internal::INVALID_CODE_POINT:
+                    utf8::internal::count_replacement();
                     out = utf8::append (replacement, out);
                     ++start;
                     // just one replacement mark for the sequence
@@ -189,7 +201,7 @@ namespace utf8
     template <typename octet_iterator, typename distance_type>
     void advance (octet_iterator& it, distance_type n, octet_iterator end)
     {
-        for (distance_type i = 0; i < n; ++i)
+        for (distance_type i = utf8::internal::bulk_advance(it, end, n); i < n; ++i)
             utf8::next(it, end);
     }
 
@@ -197,33 +209,111 @@ namespace utf8
     typename std::iterator_traits<octet_iterator>::difference_type
     distance (octet_iterator first, octet_iterator last)
     {
-        typename std::iterator_traits<octet_iterator>::difference_type dist;
-        for (dist = 0; first < last; ++dist)
+        typename std::iterator_traits<octet_iterator>::difference_type dist =
+            utf8::internal::bulk_distance(first, last);
+        for (; first < last; ++dist)
             utf8::next(first, last);
         return dist;
     }
 
+    // The lengths of the results of the conversions, checked the same way
+
+    template <typename octet_iterator>
+    typename std::iterator_traits<octet_iterator>::difference_type
+    utf8to16_length (octet_iterator start, octet_iterator end)
+    {
+        typename std::iterator_traits<octet_iterator>::difference_type length =
+            utf8::internal::bulk_utf8to16_length(start, end, true);
+        while (start != end)
+            length += utf8::next(start, end) > 0xffff ? 2 : 1;
+        return length;
+    }
+
+    template <typename octet_iterator>
+    inline typename std::iterator_traits<octet_iterator>::difference_type
+    utf8to32_length (octet_iterator start, octet_iterator end)
+    {
+        return utf8::distance(start, end);
+    }
+
+    template <typename u16bit_iterator>
+    typename std::iterator_traits<u16bit_iterator>::difference_type
+    utf16to8_length (u16bit_iterator start, u16bit_iterator end)
+    {
+        typename std::iterator_traits<u16bit_iterator>::difference_type length = 0;
+        while (start != end) {
+            length += utf8::internal::bulk_utf16to8_length(start, end, true);
+            if (start == end)
+                break;
+
+            uint32_t cp = utf8::internal::mask16(*start++);
+            if (utf8::internal::is_lead_surrogate(cp)) {
+                if (start == end)
+                    throw invalid_utf16(static_cast<uint16_t>(cp));
+                uint32_t trail_surrogate = utf8::internal::mask16(*start++);
+                if (!utf8::internal::is_trail_surrogate(trail_surrogate))
+                    throw invalid_utf16(static_cast<uint16_t>(trail_surrogate));
+                length += 4;
+            }
+            else if (utf8::internal::is_trail_surrogate(cp))
+                throw invalid_utf16(static_cast<uint16_t>(cp));
+            else
+                length += cp < 0x80 ? 1 : (cp < 0x800 ? 2 : 3);
+        }
+        return length;
+    }
+
+    template <typename u32bit_iterator>
+    typename std::iterator_traits<u32bit_iterator>::difference_type
+    utf32to8_length (u32bit_iterator start, u32bit_iterator end)
+    {
+        typename std::iterator_traits<u32bit_iterator>::difference_type length = 0;
+        while (start != end) {
+            length += utf8::internal::bulk_utf32to8_length(start, end, true);
+            if (start == end)
+                break;
+
+            uint32_t cp = *start++;
+            if (!utf8::internal::is_code_point_valid(cp))
+                throw invalid_code_point(cp);
+            length += cp < 0x80 ? 1 : (cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4));
+        }
+        return length;
+    }
+
     template <typename u16bit_iterator, typename octet_iterator>
     octet_iterator utf16to8 (u16bit_iterator start, u16bit_iterator end, octet_iterator result)
     {
         while (start != end) {
+            utf8::internal::bulk_utf16to8(start, end, result);
+            if (start == end)
+                break;
+
             uint32_t cp = utf8::internal::mask16(*start++);
             // Take care of surrogate pairs first
             if (utf8::internal::is_lead_surrogate(cp)) {
                 if (start != end) {
                     uint32_t trail_surrogate = utf8::internal::mask16(*start++);
-                    if (utf8::internal::is_trail_surrogate(trail_surrogate))
+                    if (utf8::internal::is_trail_surrogate(trail_surrogate)) {
+                        utf8::internal::count_surrogate_pair();
                         cp = (cp << 10) + trail_surrogate + internal::SURROGATE_OFFSET;
-                    else
+                    }
+                    else {
+                        utf8::internal::count_invalid_utf16();
                         throw invalid_utf16(static_cast<uint16_t>(trail_surrogate));
+                    }
                 }
-                else
+                else {
+                    utf8::internal::count_invalid_utf16();
                     throw invalid_utf16(static_cast<uint16_t>(cp));
+                }
 
             }
             // Lone trail surrogate
-            else if (utf8::internal::is_trail_surrogate(cp))
+            else if (utf8::internal::is_trail_surrogate(cp)) {
+                utf8::internal::count_invalid_utf16();
                 throw invalid_utf16(static_cast<uint16_t>(cp));
+            }
 
             result = utf8::append(cp, result);
         }
@@ -233,9 +323,17 @@ namespace utf8
     template <typename u16bit_iterator, typename octet_iterator>
     u16bit_iterator utf8to16 (octet_iterator start, octet_iterator end, u16bit_iterator result)
     {
+        utf8::internal::bulk_decode_utf8<2>(start, end, result, true);
         while (start != end) {
+            utf8::internal::copy_ascii(start, end, result, true);
+            for (octet_iterator ascii_end = utf8::internal::skip_ascii(start, end, true); start != ascii_end; ++start)
+                *result++ = static_cast<uint16_t>(utf8::internal::mask8(*start));
+            if (start == end)
+                break;
+
             uint32_t cp = utf8::next(start, end);
             if (cp > 0xffff) { //make a surrogate pair
+                utf8::internal::count_surrogate_pair();
                 *result++ = static_cast<uint16_t>((cp >> 10)   + internal::LEAD_OFFSET);
                 *result++ = static_cast<uint16_t>((cp & 0x3ff) + internal::TRAIL_SURROGATE_MIN);
             }
@@ -248,8 +346,12 @@ namespace utf8
     template <typename octet_iterator, typename u32bit_iterator>
     octet_iterator utf32to8 (u32bit_iterator start, u32bit_iterator end, octet_iterator result)
     {
-        while (start != end)
+        while (start != end) {
+            utf8::internal::bulk_utf32to8(start, end, result, true);
+            if (start == end)
+                break;
             result = utf8::append(*(start++), result);
+        }
 
         return result;
     }
@@ -257,12 +359,211 @@ namespace utf8
     template <typename octet_iterator, typename u32bit_iterator>
     u32bit_iterator utf8to32 (octet_iterator start, octet_iterator end, u32bit_iterator result)
     {
-        while (start != end)
-            (*result++) = utf8::next(start, end);
+        utf8::internal::bulk_decode_utf8<4>(start, end, result, true);
+        while (start != end) {
+            utf8::internal::copy_ascii(start, end, result, true);
+            for (octet_iterator ascii_end = utf8::internal::skip_ascii(start, end, true); start != ascii_end; ++start)
+                (*result++) = utf8::internal::mask8(*start);
+            if (start != end)
+                (*result++) = utf8::next(start, end);
+        }
 
         return result;
     }
 
+    // Conversions into an output of limited room. Rather than throw, they
+    // stop at the first code point that they cannot convert, or that does
+    // not fit, and report where and why; the caller can make room or supply
+    // more input and carry on from there.
+
+    enum conversion_status {
+        conversion_ok,                 // the whole input was converted
+        conversion_output_full,        // the next code point does not fit
+        conversion_incomplete,         // the input ends inside a sequence
+        conversion_invalid_utf8,
+        conversion_invalid_utf16,
+        conversion_invalid_code_point
+    };
+
+    template <typename input_iterator, typename output_iterator>
+    struct conversion_result {
+        input_iterator in;          // the first unit of input not converted
+        output_iterator out;        // past the last unit written
+        std::size_t consumed;       // units of input converted
+        std::size_t written;        // units of output written
+        conversion_status status;
+    };
+
+namespace internal
+{
+    template <typename input_iterator, typename output_iterator>
+    inline conversion_result<input_iterator, output_iterator>
+    make_conversion_result(input_iterator in, output_iterator out, std::size_t consumed,
+                           std::size_t written, conversion_status status)
+    {
+        conversion_result<input_iterator, output_iterator> result = {in, out, consumed, written, status};
+        return result;
+    }
+
+    inline conversion_status utf8_conversion_status(utf_error err_code)
+    {
+        switch (err_code) {
+            case UTF8_OK:
+                return conversion_ok;
+            case NOT_ENOUGH_ROOM:
+                return conversion_incomplete;
+            case INVALID_CODE_POINT:
+                return conversion_invalid_code_point;
+            default:
+                return conversion_invalid_utf8;
+        }
+    }
+
+    template <typename octet_iterator, typename u16bit_iterator, int unit_bytes>
+    conversion_result<octet_iterator, u16bit_iterator>
+    decode_bounded (octet_iterator start, octet_iterator end, u16bit_iterator result, std::size_t room)
+    {
+        const std::size_t capacity = room;
+        std::size_t consumed = 0;
+        conversion_status status = conversion_ok;
+        while (start != end) {
+            octet_iterator bulk_start = start;
+            utf8::internal::bulk_decode_utf8<unit_bytes>(start, end, result, room);
+            consumed += std::distance(bulk_start, start);
+            if (start == end)
+                break;
+
+            octet_iterator sequence_start = start;
+            uint32_t cp = 0;
+            utf_error err_code = utf8::internal::validate_next(start, end, cp);
+            if (err_code != UTF8_OK) {
+                status = utf8::internal::utf8_conversion_status(err_code);
+                break;
+            }
+            const std::size_t units = (unit_bytes == 2 && cp > 0xffff) ? 2 : 1;
+            if (units > room) {
+                start = sequence_start;
+                status = conversion_output_full;
+                break;
+            }
+            if (units == 2) {
+                utf8::internal::count_surrogate_pair();
+                *result++ = static_cast<uint16_t>((cp >> 10)   + LEAD_OFFSET);
+                *result++ = static_cast<uint16_t>((cp & 0x3ff) + TRAIL_SURROGATE_MIN);
+            }
+            else if (unit_bytes == 2)
+                *result++ = static_cast<uint16_t>(cp);
+            else
+                *result++ = cp;
+            room -= units;
+            consumed += utf8::internal::sequence_length(sequence_start);
+        }
+        return utf8::internal::make_conversion_result(start, result, consumed, capacity - room, status);
+    }
+} // namespace internal
+
+    template <typename octet_iterator, typename u16bit_iterator>
+    inline conversion_result<octet_iterator, u16bit_iterator>
+    utf8to16_bounded (octet_iterator start, octet_iterator end, u16bit_iterator result, std::size_t room)
+    {
+        return utf8::internal::decode_bounded<octet_iterator, u16bit_iterator, 2>(start, end, result, room);
+    }
+
+    template <typename octet_iterator, typename u32bit_iterator>
+    inline conversion_result<octet_iterator, u32bit_iterator>
+    utf8to32_bounded (octet_iterator start, octet_iterator end, u32bit_iterator result, std::size_t room)
+    {
+        return utf8::internal::decode_bounded<octet_iterator, u32bit_iterator, 4>(start, end, result, room);
+    }
+
+    template <typename u16bit_iterator, typename octet_iterator>
+    conversion_result<u16bit_iterator, octet_iterator>
+    utf16to8_bounded (u16bit_iterator start, u16bit_iterator end, octet_iterator result, std::size_t room)
+    {
+        const std::size_t capacity = room;
+        std::size_t consumed = 0;
+        conversion_status status = conversion_ok;
+        while (start != end) {
+            u16bit_iterator bulk_start = start;
+            utf8::internal::bulk_utf16to8(start, end, result, room);
+            consumed += std::distance(bulk_start, start);
+            if (start == end)
+                break;
+
+            u16bit_iterator sequence_start = start;
+            uint32_t cp = utf8::internal::mask16(*start++);
+            std::size_t units = 1;
+            if (utf8::internal::is_lead_surrogate(cp)) {
+                if (start == end) {
+                    status = conversion_incomplete;
+                    start = sequence_start;
+                    break;
+                }
+                uint32_t trail_surrogate = utf8::internal::mask16(*start++);
+                if (!utf8::internal::is_trail_surrogate(trail_surrogate)) {
+                    utf8::internal::count_invalid_utf16();
+                    status = conversion_invalid_utf16;
+                    start = sequence_start;
+                    break;
+                }
+                cp = (cp << 10) + trail_surrogate + internal::SURROGATE_OFFSET;
+                units = 2;
+            }
+            else if (utf8::internal::is_trail_surrogate(cp)) {
+                utf8::internal::count_invalid_utf16();
+                status = conversion_invalid_utf16;
+                start = sequence_start;
+                break;
+            }
+
+            const std::size_t length = cp < 0x80 ? 1 : (cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4));
+            if (length > room) {
+                status = conversion_output_full;
+                start = sequence_start;
+                break;
+            }
+            if (units == 2)
+                utf8::internal::count_surrogate_pair();
+            result = utf8::append(cp, result);
+            room -= length;
+            consumed += units;
+        }
+        return utf8::internal::make_conversion_result(start, result, consumed, capacity - room, status);
+    }
+
+    template <typename u32bit_iterator, typename octet_iterator>
+    conversion_result<u32bit_iterator, octet_iterator>
+    utf32to8_bounded (u32bit_iterator start, u32bit_iterator end, octet_iterator result, std::size_t room)
+    {
+        const std::size_t capacity = room;
+        std::size_t consumed = 0;
+        conversion_status status = conversion_ok;
+        while (start != end) {
+            u32bit_iterator bulk_start = start;
+            utf8::internal::bulk_utf32to8(start, end, result, room);
+            consumed += std::distance(bulk_start, start);
+            if (start == end)
+                break;
+
+            const uint32_t cp = *start;
+            if (!utf8::internal::is_code_point_valid(cp)) {
+                utf8::internal::count_error(internal::INVALID_CODE_POINT);
+                status = conversion_invalid_code_point;
+                break;
+            }
+            const std::size_t length = cp < 0x80 ? 1 : (cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4));
+            if (length > room) {
+                status = conversion_output_full;
+                break;
+            }
+            result = utf8::append(cp, result);
+            ++start;
+            room -= length;
+            ++consumed;
+        }
+        return utf8::internal::make_conversion_result(start, result, consumed, capacity - room, status);
+    }
+
     // The iterator class
     template <typename octet_iterator>
     class iterator : public std::iterator <std::bidirectional_iterator_tag, uint32_t> {
@@ -320,6 +621,84 @@ namespace utf8
       }
     }; // class iterator
 
+    // An iterator that decodes each position once, when it gets there, and
+    // keeps the code point and the end of its sequence: reading is a load
+    // and moving on an assignment. Invalid octets throw when the iterator
+    // reaches them, rather than when it is read.
+    template <typename octet_iterator>
+    class cached_iterator {
+      octet_iterator it;
+      octet_iterator next_it;     // the end of the sequence at it
+      octet_iterator range_start;
+      octet_iterator range_end;
+      uint32_t cp;
+      void decode ()
+      {
+          next_it = it;
+          cp = (it == range_end) ? 0 : utf8::next(next_it, range_end);
+      }
+      public:
+      typedef std::bidirectional_iterator_tag iterator_category;
+      typedef uint32_t value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef uint32_t* pointer;
+      typedef uint32_t& reference;
+
+      cached_iterator () : cp(0) {}
+      explicit cached_iterator (const octet_iterator& octet_it,
+                                const octet_iterator& range_start,
+                                const octet_iterator& range_end) :
+               it(octet_it), range_start(range_start), range_end(range_end)
+      {
+          if (it < range_start || it > range_end)
+              throw std::out_of_range("Invalid utf-8 iterator position");
+          decode();
+      }
+      // the default "big three" are OK
+      octet_iterator base () const { return it; }
+      uint32_t operator * () const { return cp; }
+      bool operator == (const cached_iterator& rhs) const
+      {
+          if (range_start != rhs.range_start || range_end != rhs.range_end)
+              throw std::logic_error("Comparing utf-8 iterators defined with different ranges");
+          return (it == rhs.it);
+      }
+      bool operator != (const cached_iterator& rhs) const
+      {
+          return !(operator == (rhs));
+      }
+      cached_iterator& operator ++ ()
+      {
+          if (it == range_end)
+              throw not_enough_room();
+          it = next_it;
+          decode();
+          return *this;
+      }
+      cached_iterator operator ++ (int)
+      {
+          cached_iterator temp = *this;
+          ++(*this);
+          return temp;
+      }
+      cached_iterator& operator -- ()
+      {
+          // prior decodes the sequence it steps back to. That sequence may
+          // end short of where it was, before stray trail octets, which ++
+          // then reaches and throws for.
+          cp = utf8::prior(it, range_start);
+          next_it = it;
+          std::advance(next_it, utf8::internal::sequence_length(it));
+          return *this;
+      }
+      cached_iterator operator -- (int)
+      {
+          cached_iterator temp = *this;
+          --(*this);
+          return temp;
+      }
+    }; // class cached_iterator
+
 } // namespace utf8
 
 #endif //header guard
@@ -28,6 +28,8 @@ DEALINGS IN THE SOFTWARE.
 #ifndef UTF8_FOR_CPP_CORE_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
 #define UTF8_FOR_CPP_CORE_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
 
+#include "instrument.h"
+#include "simd.h"
 #include <iterator>
 
 namespace utf8
@@ -112,163 +114,121 @@ namespace internal
             return 0;
     }
 
-    template <typename octet_difference_type>
-    inline bool is_overlong_sequence(uint32_t cp, octet_difference_type length)
-    {
-        if (cp < 0x80) {
-            if (length != 1) 
-                return true;
-        }
-        else if (cp < 0x800) {
-            if (length != 2) 
-                return true;
-        }
-        else if (cp < 0x10000) {
-            if (length != 3) 
-                return true;
-        }
-
-        return false;
-    }
-
     enum utf_error {UTF8_OK, NOT_ENOUGH_ROOM, INVALID_LEAD, INCOMPLETE_SEQUENCE, OVERLONG_SEQUENCE, INVALID_CODE_POINT};
 
-    /// Helper for get_sequence_x
-    template <typename octet_iterator>
-    utf_error increase_safely(octet_iterator& it, octet_iterator end)
-    {
-        if (++it == end)
-            return NOT_ENOUGH_ROOM;
-
-        if (!utf8::internal::is_trail(*it))
-            return INCOMPLETE_SEQUENCE;
-        
-        return UTF8_OK;
-    }
-
-    #define UTF8_CPP_INCREASE_AND_RETURN_ON_ERROR(IT, END) {utf_error ret = increase_safely(IT, END); if (ret != UTF8_OK) return ret;}    
+    // validate_next runs a small state machine over the octets of a
+    // sequence. Each octet is mapped to one of 16 classes:
+    //    0: 00-7f     1: 80-8c     2: 8d        3: 8e-8f
+    //    4: 90-9f     5: a0-bf     6: c0-c1     7: c2-df
+    //    8: e0        9: e1-ec, ee-ef           10: ed
+    //   11: f0       12: f1-f3    13: f4       14: f5-f7    15: f8-ff
+    const uint8_t dfa_octet_class[256] = {
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 00-0f
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 10-1f
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 20-2f
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 30-3f
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 40-4f
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 50-5f
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 60-6f
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,   // 70-7f
+         1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  3,  3,   // 80-8f
+         4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,   // 90-9f
+         5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,   // a0-af
+         5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,   // b0-bf
+         6,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,   // c0-cf
+         7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,   // d0-df
+         8,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9, 10,  9,  9,   // e0-ef
+        11, 12, 12, 12, 13, 14, 14, 14, 15, 15, 15, 15, 15, 15, 15, 15    // f0-ff
+    };
+
+    // The states while a sequence is pending follow the utf_error values,
+    // which are the final states. A sequence that turns out to be overlong,
+    // or to encode a surrogate or a value above 0x10ffff, is only reported
+    // once it is complete, so that a missing trail octet takes precedence.
+    enum dfa_state {
+        DFA_LEAD = INVALID_CODE_POINT + 1,
+        DFA_1_LEFT,                 // trail octets left
+        DFA_1_LEFT_OVERLONG,
+        DFA_1_LEFT_INVALID,         // the code point is not valid
+        DFA_2_LEFT,
+        DFA_2_LEFT_OVERLONG,
+        DFA_2_LEFT_INVALID,
+        DFA_3_LEFT,
+        DFA_3_LEFT_INVALID,
+        DFA_AFTER_E0,               // the second octet decides
+        DFA_AFTER_ED,
+        DFA_AFTER_F0,
+        DFA_AFTER_F0_8D,            // the third octet decides
+        DFA_AFTER_F4
+    };
+
+    const uint8_t dfa_transitions[][16] = {
+        { 0,  2,  2,  2,  2,  2,  8,  7, 15, 10, 16, 17, 13, 19, 14,  2},   // DFA_LEAD
+        { 3,  0,  0,  0,  0,  0,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_1_LEFT
+        { 3,  4,  4,  4,  4,  4,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_1_LEFT_OVERLONG
+        { 3,  5,  5,  5,  5,  5,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_1_LEFT_INVALID
+        { 3,  7,  7,  7,  7,  7,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_2_LEFT
+        { 3,  8,  8,  8,  8,  8,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_2_LEFT_OVERLONG
+        { 3,  9,  9,  9,  9,  9,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_2_LEFT_INVALID
+        { 3, 10, 10, 10, 10, 10,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_3_LEFT
+        { 3, 12, 12, 12, 12, 12,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_3_LEFT_INVALID
+        { 3,  8,  8,  8,  8,  7,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_AFTER_E0
+        { 3,  7,  7,  7,  7,  9,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_AFTER_ED
+        { 3, 11, 18, 11, 10, 10,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_AFTER_F0
+        { 3,  8,  8,  8,  8,  9,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3},   // DFA_AFTER_F0_8D
+        { 3, 10, 10, 10, 12, 12,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3}    // DFA_AFTER_F4
+    };
+
+    // The bits of the code point that the lead octet of each class carries
+    const uint8_t dfa_lead_bits[16] = {
+        0x7f, 0, 0, 0, 0, 0, 0x1f, 0x1f, 0x0f, 0x0f, 0x0f, 0x07, 0x07, 0x07, 0x07, 0
+    };
 
-    /// get_sequence_x functions decode utf-8 sequences of the length x
     template <typename octet_iterator>
-    utf_error get_sequence_1(octet_iterator& it, octet_iterator end, uint32_t& code_point)
-    {
-        if (it == end)
-            return NOT_ENOUGH_ROOM;
-
-        code_point = utf8::internal::mask8(*it);
-
-        return UTF8_OK;
-    }
-
-    template <typename octet_iterator>
-    utf_error get_sequence_2(octet_iterator& it, octet_iterator end, uint32_t& code_point)
-    {
-        if (it == end) 
-            return NOT_ENOUGH_ROOM;
-        
-        code_point = utf8::internal::mask8(*it);
-
-        UTF8_CPP_INCREASE_AND_RETURN_ON_ERROR(it, end)
-
-        code_point = ((code_point << 6) & 0x7ff) + ((*it) & 0x3f);
-
-        return UTF8_OK;
-    }
-
-    template <typename octet_iterator>
-    utf_error get_sequence_3(octet_iterator& it, octet_iterator end, uint32_t& code_point)
+    utf_error validate_next(octet_iterator& it, octet_iterator end, uint32_t& code_point)
     {
-        if (it == end)
+        if (it == end) {
+            utf8::internal::count_error(NOT_ENOUGH_ROOM);
             return NOT_ENOUGH_ROOM;
-            
-        code_point = utf8::internal::mask8(*it);
-
-        UTF8_CPP_INCREASE_AND_RETURN_ON_ERROR(it, end)
-
-        code_point = ((code_point << 12) & 0xffff) + ((utf8::internal::mask8(*it) << 6) & 0xfff);
-
-        UTF8_CPP_INCREASE_AND_RETURN_ON_ERROR(it, end)
-
-        code_point += (*it) & 0x3f;
-
-        return UTF8_OK;
-    }
-
-    template <typename octet_iterator>
-    utf_error get_sequence_4(octet_iterator& it, octet_iterator end, uint32_t& code_point)
-    {
-        if (it == end)
-           return NOT_ENOUGH_ROOM;
-
-        code_point = utf8::internal::mask8(*it);
-
-        UTF8_CPP_INCREASE_AND_RETURN_ON_ERROR(it, end)
-
-        code_point = ((code_point << 18) & 0x1fffff) + ((utf8::internal::mask8(*it) << 12) & 0x3ffff);
-
-        UTF8_CPP_INCREASE_AND_RETURN_ON_ERROR(it, end)
-
-        code_point += (utf8::internal::mask8(*it) << 6) & 0xfff;
-
-        UTF8_CPP_INCREASE_AND_RETURN_ON_ERROR(it, end)
-
-        code_point += (*it) & 0x3f;
-
-        return UTF8_OK;
-    }
+        }
 
-    #undef UTF8_CPP_INCREASE_AND_RETURN_ON_ERROR
+        uint32_t cp = utf8::internal::mask8(*it);
+        if (cp < 0x80) {
+            utf8::internal::count_decoded(1);
+            code_point = cp;
+            ++it;
+            return UTF8_OK;
+        }
 
-    template <typename octet_iterator>
-    utf_error validate_next(octet_iterator& it, octet_iterator end, uint32_t& code_point)
-    {
         // Save the original value of it so we can go back in case of failure
         // Of course, it does not make much sense with i.e. stream iterators
         octet_iterator original_it = it;
 
-        uint32_t cp = 0;
-        // Determine the sequence length based on the lead octet
-        typedef typename std::iterator_traits<octet_iterator>::difference_type octet_difference_type;
-        const octet_difference_type length = utf8::internal::sequence_length(it);
-
-        // Get trail octets and calculate the code point
-        utf_error err = UTF8_OK;
-        switch (length) {
-            case 0: 
-                return INVALID_LEAD;
-            case 1:
-                err = utf8::internal::get_sequence_1(it, end, cp);
-                break;
-            case 2:
-                err = utf8::internal::get_sequence_2(it, end, cp);
-            break;
-            case 3:
-                err = utf8::internal::get_sequence_3(it, end, cp);
-            break;
-            case 4:
-                err = utf8::internal::get_sequence_4(it, end, cp);
-            break;
-        }
-
-        if (err == UTF8_OK) {
-            // Decoding succeeded. Now, security checks...
-            if (utf8::internal::is_code_point_valid(cp)) {
-                if (!utf8::internal::is_overlong_sequence(cp, length)){
-                    // Passed! Return here.
-                    code_point = cp;
-                    ++it;
-                    return UTF8_OK;
-                }
-                else
-                    err = OVERLONG_SEQUENCE;
+        const unsigned lead_class = dfa_octet_class[cp];
+        unsigned state = dfa_transitions[0][lead_class];
+        cp &= dfa_lead_bits[lead_class];
+        unsigned length = 1;
+        for (; state >= DFA_LEAD; ++length) {
+            if (++it == end) {
+                it = original_it;
+                utf8::internal::count_error(NOT_ENOUGH_ROOM);
+                return NOT_ENOUGH_ROOM;
             }
-            else 
-                err = INVALID_CODE_POINT;
+            const uint8_t octet = utf8::internal::mask8(*it);
+            cp = (cp << 6) | (octet & 0x3f);
+            state = dfa_transitions[state - DFA_LEAD][dfa_octet_class[octet]];
         }
 
-        // Failure branch - restore the original value of the iterator
-        it = original_it;
-        return err;
+        if (state != UTF8_OK) {
+            // Failure branch - restore the original value of the iterator
+            it = original_it;
+            utf8::internal::count_error(static_cast<int>(state));
+            return static_cast<utf_error>(state);
+        }
+        utf8::internal::count_decoded(length);
+        code_point = cp;
+        ++it;
+        return UTF8_OK;
     }
 
     template <typename octet_iterator>
@@ -287,8 +247,11 @@ namespace internal
     template <typename octet_iterator>
     octet_iterator find_invalid(octet_iterator start, octet_iterator end)
     {
-        octet_iterator result = start;
+        octet_iterator result = utf8::internal::skip_valid(start, end);
         while (result != end) {
+            result = utf8::internal::skip_ascii(result, end, true);
+            if (result == end)
+                break;
             utf8::internal::utf_error err_code = utf8::internal::validate_next(result, end);
             if (err_code != internal::UTF8_OK)
                 return result;
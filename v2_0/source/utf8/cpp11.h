@@ -0,0 +1,83 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_CPP11_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_CPP11_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+#include "checked.h"
+#include "unchecked.h"
+#include <string>
+
+namespace utf8
+{
+    // Conversions of whole strings. Each result is sized once, from the
+    // checked length of the input, and then filled in place; since that
+    // has checked the input already, the fill takes the unchecked path.
+
+    inline std::u16string utf8to16(const std::string& s)
+    {
+        const char* start = s.data();
+        const char* end = start + s.size();
+        std::u16string result(static_cast<std::size_t>(utf8::utf8to16_length(start, end)), u'\0');
+        if (!result.empty())
+            utf8::unchecked::utf8to16(start, end, &result[0]);
+        return result;
+    }
+
+    inline std::u32string utf8to32(const std::string& s)
+    {
+        const char* start = s.data();
+        const char* end = start + s.size();
+        std::u32string result(static_cast<std::size_t>(utf8::utf8to32_length(start, end)), U'\0');
+        if (!result.empty())
+            utf8::unchecked::utf8to32(start, end, &result[0]);
+        return result;
+    }
+
+    inline std::string utf16to8(const std::u16string& s)
+    {
+        const char16_t* start = s.data();
+        const char16_t* end = start + s.size();
+        std::string result(static_cast<std::size_t>(utf8::utf16to8_length(start, end)), '\0');
+        if (!result.empty())
+            utf8::unchecked::utf16to8(start, end, &result[0]);
+        return result;
+    }
+
+    inline std::string utf32to8(const std::u32string& s)
+    {
+        const char32_t* start = s.data();
+        const char32_t* end = start + s.size();
+        std::string result(static_cast<std::size_t>(utf8::utf32to8_length(start, end)), '\0');
+        if (!result.empty())
+            utf8::unchecked::utf32to8(start, end, &result[0]);
+        return result;
+    }
+
+} // namespace utf8
+
+#endif // header guard
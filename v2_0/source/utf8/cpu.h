@@ -0,0 +1,176 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_CPU_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_CPU_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+// Detection of the instruction sets the bulk kernels in simd.h can use.
+// The check runs once, on first use; the UTF8_CPP_SIMD environment
+// variable (scalar, sse2, sse4.2, avx2 or avx512bw) or set_simd_level
+// can lower the level, e.g. to test the less capable kernels.
+// Define UTF8_CPP_NO_SIMD to build the plain scalar code only.
+
+#ifndef UTF8_CPP_NO_SIMD
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define UTF8_CPP_X86
+#include <cpuid.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define UTF8_CPP_X86
+#include <intrin.h>
+#endif
+#endif // #ifndef UTF8_CPP_NO_SIMD
+
+#include <cstdlib>
+#include <cstring>
+
+namespace utf8
+{
+    /// Instruction set levels of the bulk kernels, from the least capable
+    enum simd_level {
+        simd_scalar,
+        simd_sse2,
+        simd_sse42,
+        simd_avx2,
+        simd_avx512bw
+    };
+
+// Helper code - not intended to be directly called by the library users. May be changed at any time
+namespace internal
+{
+#ifdef UTF8_CPP_X86
+    inline void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; ++i)
+            regs[i] = static_cast<unsigned>(info[i]);
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // The register state the operating system saves on a context switch
+    inline unsigned enabled_state()
+    {
+#ifdef _MSC_VER
+        return static_cast<unsigned>(_xgetbv(0));
+#else
+        unsigned eax, edx;
+        __asm__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return eax;
+#endif
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    inline simd_level detect_simd_level()
+    {
+#ifdef UTF8_CPP_X86
+        unsigned regs[4];
+        utf8::internal::cpuid(0, 0, regs);
+        const unsigned max_leaf = regs[0];
+        if (max_leaf < 1)
+            return simd_scalar;
+
+        utf8::internal::cpuid(1, 0, regs);
+        if (!(regs[3] & (1u << 26)))        // SSE2
+            return simd_scalar;
+        if (!(regs[2] & (1u << 9)) || !(regs[2] & (1u << 20)))  // SSSE3, SSE4.2
+            return simd_sse2;
+        if (!(regs[2] & (1u << 27)) || !(regs[2] & (1u << 28)) || max_leaf < 7)  // OSXSAVE, AVX
+            return simd_sse42;
+        const unsigned state = utf8::internal::enabled_state();
+        if ((state & 0x6) != 0x6)           // XMM and YMM registers
+            return simd_sse42;
+
+        utf8::internal::cpuid(7, 0, regs);
+        if (!(regs[1] & (1u << 5)))         // AVX2
+            return simd_sse42;
+        if (!(regs[1] & (1u << 16)) || !(regs[1] & (1u << 30)) || (state & 0xe6) != 0xe6)  // AVX-512F, BW, ZMM state
+            return simd_avx2;
+        return simd_avx512bw;
+#else
+        return simd_scalar;
+#endif
+    }
+
+    // The level named by UTF8_CPP_SIMD, or simd_avx512bw when it is not set
+    // or names no level
+    inline simd_level requested_simd_level()
+    {
+        static const char* const names[] = {"scalar", "sse2", "sse4.2", "avx2", "avx512bw"};
+        const char* requested = std::getenv("UTF8_CPP_SIMD");
+        if (requested)
+            for (int level = simd_scalar; level <= simd_avx512bw; ++level)
+                if (std::strcmp(requested, names[level]) == 0)
+                    return static_cast<simd_level>(level);
+        return simd_avx512bw;
+    }
+
+    inline simd_level supported_level()
+    {
+        static const simd_level level = utf8::internal::detect_simd_level();
+        return level;
+    }
+
+    inline simd_level lower_level(simd_level a, simd_level b)
+    {
+        return a < b ? a : b;
+    }
+
+    inline simd_level& active_simd_level()
+    {
+        static simd_level level = utf8::internal::lower_level(utf8::internal::requested_simd_level(),
+                                                              utf8::internal::supported_level());
+        return level;
+    }
+} // namespace internal
+
+    /// Returns the most capable level this processor and operating system support
+    inline simd_level supported_simd_level()
+    {
+        return utf8::internal::supported_level();
+    }
+
+    /// Returns the level the bulk kernels run at
+    inline simd_level simd_level_in_use()
+    {
+        return utf8::internal::active_simd_level();
+    }
+
+    /// Sets the level the bulk kernels run at; a level above the supported
+    /// one is lowered to it. Not synchronized with conversions running on
+    /// other threads. Returns the level in use from now on.
+    inline simd_level set_simd_level(simd_level level)
+    {
+        utf8::internal::active_simd_level() = utf8::internal::lower_level(level, utf8::internal::supported_level());
+        return utf8::internal::active_simd_level();
+    }
+} // namespace utf8
+
+#endif // header guard
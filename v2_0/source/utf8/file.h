@@ -0,0 +1,328 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_FILE_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_FILE_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+#include "checked.h"
+#include "unchecked.h"
+
+// Files are mapped into memory with mmap where the system has it, and read
+// into memory otherwise. Define UTF8_CPP_NO_MMAP to always read them.
+
+#ifndef UTF8_CPP_NO_MMAP
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define UTF8_CPP_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#endif // #ifndef UTF8_CPP_NO_MMAP
+
+#include <cerrno>
+#include <fstream>
+#include <vector>
+
+namespace utf8
+{
+    // Thrown when a file cannot be read or written; carries errno
+    class file_error : public exception {
+        int error;
+    public:
+        explicit file_error (int error) : error(error) {}
+        virtual const char* what() const throw() { return "Could not read or write a file"; }
+        int error_number() const {return error;}
+    };
+
+namespace internal
+{
+    class output_file;
+}
+
+    /// The contents of a file, mapped read-only for sequential access.
+    /// Files that cannot be mapped, such as pipes, are read into memory.
+    class mapped_file {
+        const char* data;
+        std::size_t length;
+        void* mapping;
+        std::vector<char> contents;
+#ifdef UTF8_CPP_MMAP
+        // the file that is mapped, which must not be written over
+        dev_t device;
+        ino_t inode;
+        friend class internal::output_file;
+#endif
+        // not copyable
+        mapped_file (const mapped_file&);
+        mapped_file& operator = (const mapped_file&);
+        void take_contents()
+        {
+            length = contents.size();
+            data = length ? &contents[0] : 0;
+        }
+    public:
+        explicit mapped_file (const char* path) : data(0), length(0), mapping(0)
+        {
+#ifdef UTF8_CPP_MMAP
+            const int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+                throw file_error(errno);
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                const int error = errno;
+                ::close(fd);
+                throw file_error(error);
+            }
+            device = info.st_dev;
+            inode = info.st_ino;
+            if (S_ISREG(info.st_mode)) {
+                length = static_cast<std::size_t>(info.st_size);
+                if (length != 0) {
+                    mapping = ::mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (mapping == MAP_FAILED) {
+                        const int error = errno;
+                        mapping = 0;
+                        ::close(fd);
+                        throw file_error(error);
+                    }
+                    ::madvise(mapping, length, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(mapping);
+                }
+            }
+            else {
+                char buffer[65536];
+                ssize_t count;
+                while ((count = ::read(fd, buffer, sizeof(buffer))) != 0) {
+                    if (count > 0)
+                        contents.insert(contents.end(), buffer, buffer + count);
+                    else if (errno != EINTR)
+                        break;
+                }
+                if (count < 0) {
+                    const int error = errno;
+                    ::close(fd);
+                    throw file_error(error);
+                }
+                take_contents();
+            }
+            ::close(fd);
+#else
+            // The streams do not promise to set errno, so the error number
+            // of a failure here may be zero
+            errno = 0;
+            std::ifstream file(path, std::ios::in | std::ios::binary);
+            if (!file.is_open())
+                throw file_error(errno);
+            contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            if (file.bad())
+                throw file_error(errno);
+            take_contents();
+#endif
+        }
+        ~mapped_file ()
+        {
+#ifdef UTF8_CPP_MMAP
+            if (mapping)
+                ::munmap(mapping, length);
+#endif
+        }
+        const char* begin () const { return data; }
+        const char* end () const { return data + length; }
+        std::size_t size () const { return length; }
+    }; // class mapped_file
+
+namespace internal
+{
+    // A new file of a given size, written in place through a shared mapping;
+    // finish flushes it. Without mmap it is built in memory and written out.
+    // The file must not be the mapped input, which truncating it would
+    // destroy while it is read; that throws file_error(EINVAL) before the
+    // file is touched.
+    class output_file {
+        char* data;
+        std::size_t length;
+        void* mapping;
+        int fd;
+        const char* path;
+        std::vector<char> contents;
+        output_file (const output_file&);
+        output_file& operator = (const output_file&);
+    public:
+        output_file (const char* path, std::size_t size, const mapped_file& input) : data(0), length(size), mapping(0), fd(-1), path(path)
+        {
+#ifdef UTF8_CPP_MMAP
+            fd = ::open(path, O_RDWR | O_CREAT, 0666);
+            if (fd < 0)
+                throw file_error(errno);
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                const int error = errno;
+                ::close(fd);
+                throw file_error(error);
+            }
+            if (input.mapping && info.st_dev == input.device && info.st_ino == input.inode) {
+                ::close(fd);
+                throw file_error(EINVAL);
+            }
+            if (::ftruncate(fd, static_cast<off_t>(length)) != 0) {
+                const int error = errno;
+                ::close(fd);
+                throw file_error(error);
+            }
+            if (length != 0) {
+                if ((mapping = ::mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+                    const int error = errno;
+                    mapping = 0;
+                    ::close(fd);
+                    throw file_error(error);
+                }
+                ::madvise(mapping, length, MADV_SEQUENTIAL);
+                data = static_cast<char*>(mapping);
+            }
+#else
+            (void)input;
+            contents.resize(length);
+            data = length ? &contents[0] : 0;
+#endif
+        }
+        ~output_file ()
+        {
+#ifdef UTF8_CPP_MMAP
+            if (mapping)
+                ::munmap(mapping, length);
+            if (fd >= 0)
+                ::close(fd);
+#endif
+        }
+        char* begin () { return data; }
+        void finish ()
+        {
+#ifdef UTF8_CPP_MMAP
+            if (mapping && ::munmap(mapping, length) != 0)
+                throw file_error(errno);
+            mapping = 0;
+            const int closed = ::close(fd);
+            fd = -1;
+            if (closed != 0)
+                throw file_error(errno);
+#else
+            errno = 0; // the stream may not set it, as in mapped_file
+            std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file.is_open() || !file.write(data, static_cast<std::streamsize>(length)))
+                throw file_error(errno);
+#endif
+        }
+    }; // class output_file
+
+    // The units of a file of UTF-16 or UTF-32, in the byte order of the
+    // machine; a partial unit at the end is incomplete input
+    template <typename unit_type>
+    inline const unit_type* file_units_end(const mapped_file& file)
+    {
+        if (file.size() % sizeof(unit_type))
+            throw not_enough_room();
+        return reinterpret_cast<const unit_type*>(file.end());
+    }
+} // namespace internal
+
+    // Validation, counting and conversions of whole files. The input is
+    // mapped and processed in place; a conversion takes the length of its
+    // result first, which checks the input, and then writes it straight
+    // into the mapped output file. UTF-16 and UTF-32 files are in the byte
+    // order of the machine and have no byte order mark added or removed.
+    namespace file
+    {
+        /// The offset of the first invalid octet in the file, or its size
+        inline std::size_t find_invalid(const char* path)
+        {
+            mapped_file input(path);
+            return static_cast<std::size_t>(utf8::find_invalid(input.begin(), input.end()) - input.begin());
+        }
+
+        inline bool is_valid(const char* path)
+        {
+            mapped_file input(path);
+            return utf8::is_valid(input.begin(), input.end());
+        }
+
+        /// The number of code points in the file
+        inline std::size_t distance(const char* path)
+        {
+            mapped_file input(path);
+            return static_cast<std::size_t>(utf8::distance(input.begin(), input.end()));
+        }
+
+        /// Each conversion returns the number of units it wrote. The output
+        /// must not be the input file: with mmap that throws file_error.
+        inline std::size_t utf8to16(const char* from, const char* to)
+        {
+            mapped_file input(from);
+            const std::size_t length = static_cast<std::size_t>(utf8::utf8to16_length(input.begin(), input.end()));
+            internal::output_file output(to, length * sizeof(uint16_t), input);
+            utf8::unchecked::utf8to16(input.begin(), input.end(), reinterpret_cast<uint16_t*>(output.begin()));
+            output.finish();
+            return length;
+        }
+
+        inline std::size_t utf8to32(const char* from, const char* to)
+        {
+            mapped_file input(from);
+            const std::size_t length = static_cast<std::size_t>(utf8::utf8to32_length(input.begin(), input.end()));
+            internal::output_file output(to, length * sizeof(uint32_t), input);
+            utf8::unchecked::utf8to32(input.begin(), input.end(), reinterpret_cast<uint32_t*>(output.begin()));
+            output.finish();
+            return length;
+        }
+
+        inline std::size_t utf16to8(const char* from, const char* to)
+        {
+            mapped_file input(from);
+            const uint16_t* start = reinterpret_cast<const uint16_t*>(input.begin());
+            const uint16_t* end = utf8::internal::file_units_end<uint16_t>(input);
+            const std::size_t length = static_cast<std::size_t>(utf8::utf16to8_length(start, end));
+            internal::output_file output(to, length, input);
+            utf8::unchecked::utf16to8(start, end, output.begin());
+            output.finish();
+            return length;
+        }
+
+        inline std::size_t utf32to8(const char* from, const char* to)
+        {
+            mapped_file input(from);
+            const uint32_t* start = reinterpret_cast<const uint32_t*>(input.begin());
+            const uint32_t* end = utf8::internal::file_units_end<uint32_t>(input);
+            const std::size_t length = static_cast<std::size_t>(utf8::utf32to8_length(start, end));
+            internal::output_file output(to, length, input);
+            utf8::unchecked::utf32to8(start, end, output.begin());
+            output.finish();
+            return length;
+        }
+    } // namespace utf8::file
+} // namespace utf8
+
+#endif // header guard
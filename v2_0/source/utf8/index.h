@@ -0,0 +1,219 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_INDEX_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_INDEX_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+#include "checked.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace utf8
+{
+    // Maps positions in a UTF-8 text between octets, code points and UTF-16
+    // units. It keeps a checkpoint every interval code points, so that a
+    // lookup is a binary search and a walk of at most interval code points,
+    // and an edit rescans only the code points around it.
+    //
+    // The index does not hold the text. The functions that read it take an
+    // iterator to its start, which must be random access; the text must be
+    // valid UTF-8 and the same as the one last indexed.
+    class offset_index {
+    public:
+        /// A position in the text, in each of the three measures
+        struct position {
+            std::size_t octets;
+            std::size_t code_points;
+            std::size_t units;          // UTF-16
+            position() : octets(0), code_points(0), units(0) {}
+        };
+
+        explicit offset_index (std::size_t interval = 64) : interval(interval ? interval : 1)
+        {
+            checkpoints.push_back(position());
+        }
+
+        template <typename octet_iterator>
+        offset_index (octet_iterator start, octet_iterator end, std::size_t interval = 64) : interval(interval ? interval : 1)
+        {
+            build(start, end);
+        }
+
+        /// Indexes [start, end) anew. Invalid UTF-8 throws as utf8::next does.
+        template <typename octet_iterator>
+        void build (octet_iterator start, octet_iterator end)
+        {
+            checkpoints.assign(1, position());
+            total = position();
+            total = scan(start, total, static_cast<std::size_t>(std::distance(start, end)));
+        }
+
+        /// The end of the text
+        const position& size() const { return total; }
+
+        /// The position of the code point at the given index, or of the one
+        /// that holds the given UTF-16 unit or octet. An index past the end
+        /// of the text throws not_enough_room; the end itself is allowed.
+        template <typename octet_iterator>
+        position locate_code_point (octet_iterator text, std::size_t code_point) const
+        {
+            return locate(text, code_point, &position::code_points);
+        }
+
+        template <typename octet_iterator>
+        position locate_unit (octet_iterator text, std::size_t unit) const
+        {
+            return locate(text, unit, &position::units);
+        }
+
+        template <typename octet_iterator>
+        position locate_octet (octet_iterator text, std::size_t octet) const
+        {
+            return locate(text, octet, &position::octets);
+        }
+
+        /// Brings the index up to date after an edit that replaced the
+        /// octets [offset, offset + removed) of the text with inserted new
+        /// ones; text is the start of the edited text. Both ends of the edit
+        /// must fall on sequence boundaries. Otherwise, or if the inserted
+        /// octets are not valid UTF-8, it throws as utf8::next does, and the
+        /// index has to be built anew.
+        template <typename octet_iterator>
+        void update (octet_iterator text, std::size_t offset, std::size_t removed, std::size_t inserted)
+        {
+            if (offset > total.octets || removed > total.octets - offset)
+                throw not_enough_room();
+
+            // The checkpoints up to the edit stay as they are; the ones past
+            // it keep their place in the text, and shift with it
+            std::vector<position>::iterator kept_end =
+                std::upper_bound(checkpoints.begin(), checkpoints.end(), offset, measure_less(&position::octets));
+            std::vector<position>::iterator moved =
+                std::lower_bound(kept_end, checkpoints.end(), offset + removed, measure_less(&position::octets));
+            std::vector<position> tail(moved, checkpoints.end());
+            checkpoints.erase(kept_end, checkpoints.end());
+
+            // Rescan from the last kept checkpoint to the first moved one
+            const position old_resume = tail.empty() ? total : tail.front();
+            const position resume = scan(text, checkpoints.back(), old_resume.octets - removed + inserted);
+            for (std::size_t i = 0; i < tail.size(); ++i)
+                shift(tail[i], old_resume, resume);
+            shift(total, old_resume, resume);
+
+            // Drop the moved checkpoints that have come too close to the
+            // rescanned ones
+            std::size_t first = 0;
+            for (; first < tail.size(); ++first) {
+                const position& following = first + 1 < tail.size() ? tail[first + 1] : total;
+                if (following.code_points - checkpoints.back().code_points > interval)
+                    break;
+            }
+            checkpoints.insert(checkpoints.end(), tail.begin() + first, tail.end());
+        }
+
+    private:
+        std::vector<position> checkpoints;  // the first one is the start of the text
+        position total;
+        std::size_t interval;
+
+        // Orders positions by one of their measures
+        struct measure_less {
+            std::size_t position::*measure;
+            explicit measure_less (std::size_t position::*measure) : measure(measure) {}
+            bool operator () (std::size_t n, const position& p) const { return n < p.*measure; }
+            bool operator () (const position& p, std::size_t n) const { return p.*measure < n; }
+        };
+
+        static void shift (position& p, const position& from, const position& to)
+        {
+            // Unsigned arithmetic wraps around, so that the result is right
+            // even when the edit moves p back
+            p.octets = p.octets - from.octets + to.octets;
+            p.code_points = p.code_points - from.code_points + to.code_points;
+            p.units = p.units - from.units + to.units;
+        }
+
+        // Walks the text from at to the octet offset last, adding a
+        // checkpoint every interval code points, and returns the position
+        // of last
+        template <typename octet_iterator>
+        position scan (octet_iterator text, position at, std::size_t last)
+        {
+            typedef typename std::iterator_traits<octet_iterator>::difference_type difference_type;
+            octet_iterator it = text + static_cast<difference_type>(at.octets);
+            const octet_iterator end = text + static_cast<difference_type>(last);
+            while (it != end) {
+                std::size_t room = interval - (at.code_points - checkpoints.back().code_points);
+                if (room == 0) {
+                    checkpoints.push_back(at);
+                    room = interval;
+                }
+                // ASCII runs are one octet, code point and unit each
+                const octet_iterator limit = static_cast<std::size_t>(end - it) > room ?
+                                             it + static_cast<difference_type>(room) : end;
+                const std::size_t ascii = static_cast<std::size_t>(utf8::internal::skip_ascii(it, limit, true) - it);
+                if (ascii > 0) {
+                    it += static_cast<difference_type>(ascii);
+                    at.octets += ascii;
+                    at.code_points += ascii;
+                    at.units += ascii;
+                    continue;
+                }
+                const octet_iterator sequence_start = it;
+                const uint32_t cp = utf8::next(it, end);
+                at.octets += static_cast<std::size_t>(it - sequence_start);
+                at.code_points += 1;
+                at.units += cp > 0xffff ? 2 : 1;
+            }
+            return at;
+        }
+
+        template <typename octet_iterator>
+        position locate (octet_iterator text, std::size_t n, std::size_t position::*measure) const
+        {
+            if (n > total.*measure)
+                throw not_enough_room();
+            position at = *(std::upper_bound(checkpoints.begin(), checkpoints.end(), n, measure_less(measure)) - 1);
+            octet_iterator it = text + static_cast<std::ptrdiff_t>(at.octets);
+            while (at.*measure < n) {
+                const std::size_t length = static_cast<std::size_t>(utf8::internal::sequence_length(it));
+                position following = at;
+                following.octets += length;
+                following.code_points += 1;
+                following.units += length == 4 ? 2 : 1;
+                if (following.*measure > n)
+                    break;
+                at = following;
+                it += static_cast<std::ptrdiff_t>(length);
+            }
+            return at;
+        }
+    };
+} // namespace utf8
+
+#endif // header guard
@@ -0,0 +1,314 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_INSTRUMENT_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_INSTRUMENT_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+// Counters of what the library decodes and encodes, for telling how the
+// input of a running program shifts: sequences by length, errors by kind,
+// surrogate pairs and octets. They are off unless UTF8_CPP_INSTRUMENT is
+// defined (C++11 and later); the hooks are then empty and compile to
+// nothing. The bulk kernels of simd.h stay in an instrumented build: the
+// runs of valid UTF-8 they go over are counted afterwards, a run at a time,
+// as the per-sequence code would have counted them.
+//
+// Each thread counts into counters of its own. thread_statistics reads
+// those of the calling thread; collect_statistics adds up those of all
+// threads, including the ones that have ended.
+
+#ifdef UTF8_CPP_INSTRUMENT
+#if !(__cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L))
+#error "UTF8_CPP_INSTRUMENT requires C++11"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#endif // #ifdef UTF8_CPP_INSTRUMENT
+
+namespace utf8
+{
+namespace internal
+{
+    // What count_run counts a run as; any of these together
+    enum run_kind { run_decoded = 1, run_encoded = 2, run_surrogate_pairs = 4 };
+} // namespace internal
+
+#ifdef UTF8_CPP_INSTRUMENT
+    /// A snapshot of the counters
+    struct statistics {
+        enum counter {
+            octets_decoded,             // in valid UTF-8 sequences
+            octets_encoded,             // in UTF-8 sequences written
+            decoded_length_1,           // valid sequences, by length
+            decoded_length_2,
+            decoded_length_3,
+            decoded_length_4,
+            encoded_length_1,           // sequences written, by length
+            encoded_length_2,
+            encoded_length_3,
+            encoded_length_4,
+            surrogate_pairs,            // decoded from UTF-16 or encoded to it
+            not_enough_room_errors,     // UTF-8 errors, by kind
+            invalid_lead_errors,
+            incomplete_sequence_errors,
+            overlong_sequence_errors,
+            invalid_code_point_errors,  // also values append would not encode
+            invalid_utf16_errors,       // unpaired surrogates
+            replacements,               // made by replace_invalid
+            counter_count
+        };
+
+        std::uint64_t counts[counter_count];
+
+        std::uint64_t operator [] (counter c) const { return counts[c]; }
+
+        /// The name of a counter, as above, for exporting it
+        static const char* name(counter c)
+        {
+            static const char* const names[counter_count] = {
+                "octets_decoded", "octets_encoded",
+                "decoded_length_1", "decoded_length_2", "decoded_length_3", "decoded_length_4",
+                "encoded_length_1", "encoded_length_2", "encoded_length_3", "encoded_length_4",
+                "surrogate_pairs", "not_enough_room_errors", "invalid_lead_errors",
+                "incomplete_sequence_errors", "overlong_sequence_errors", "invalid_code_point_errors",
+                "invalid_utf16_errors", "replacements"
+            };
+            return names[c];
+        }
+
+        statistics& operator += (const statistics& rhs)
+        {
+            for (int c = 0; c < counter_count; ++c)
+                counts[c] += rhs.counts[c];
+            return *this;
+        }
+
+        /// The counts since an earlier snapshot
+        statistics operator - (const statistics& earlier) const
+        {
+            statistics difference = *this;
+            for (int c = 0; c < counter_count; ++c)
+                difference.counts[c] -= earlier.counts[c];
+            return difference;
+        }
+    };
+
+// Helper code - not intended to be directly called by the library users. May be changed at any time
+namespace internal
+{
+    class thread_counters {
+        std::atomic<std::uint64_t> counts[statistics::counter_count];
+    public:
+        thread_counters()
+        {
+            for (int c = 0; c < statistics::counter_count; ++c)
+                counts[c].store(0, std::memory_order_relaxed);
+        }
+
+        void add(int c, std::uint64_t n)
+        {
+            // Only the owning thread writes, so a load and a store will do
+            counts[c].store(counts[c].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        void add_to(statistics& total) const
+        {
+            for (int c = 0; c < statistics::counter_count; ++c)
+                total.counts[c] += counts[c].load(std::memory_order_relaxed);
+        }
+    };
+
+    struct counter_registry {
+        std::mutex lock;
+        std::vector<const thread_counters*> running;
+        statistics ended = statistics();
+    };
+
+    // Never destroyed: threads may end after the static objects are gone
+    inline counter_registry& registry()
+    {
+        static counter_registry* const instance = new counter_registry();
+        return *instance;
+    }
+
+    class registered_counters {
+        thread_counters counters;
+    public:
+        registered_counters()
+        {
+            counter_registry& r = utf8::internal::registry();
+            std::lock_guard<std::mutex> guard(r.lock);
+            r.running.push_back(&counters);
+        }
+
+        ~registered_counters()
+        {
+            counter_registry& r = utf8::internal::registry();
+            std::lock_guard<std::mutex> guard(r.lock);
+            counters.add_to(r.ended);
+            r.running.erase(std::find(r.running.begin(), r.running.end(), &counters));
+        }
+
+        thread_counters& get() { return counters; }
+    };
+
+    inline thread_counters& local_counters()
+    {
+        thread_local registered_counters counters;
+        return counters.get();
+    }
+
+    inline void count_decoded(unsigned length)
+    {
+        thread_counters& counters = utf8::internal::local_counters();
+        counters.add(statistics::octets_decoded, length);
+        counters.add(statistics::decoded_length_1 + length - 1, 1);
+    }
+
+    inline void count_encoded(unsigned cp)
+    {
+        const unsigned length = cp < 0x80 ? 1 : (cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4));
+        thread_counters& counters = utf8::internal::local_counters();
+        counters.add(statistics::octets_encoded, length);
+        counters.add(statistics::encoded_length_1 + length - 1, 1);
+    }
+
+    // error is a utf_error of core.h other than UTF8_OK; the error counters
+    // follow their order
+    inline void count_error(int error)
+    {
+        utf8::internal::local_counters().add(statistics::not_enough_room_errors + error - 1, 1);
+    }
+
+    inline void count_surrogate_pair()
+    {
+        utf8::internal::local_counters().add(statistics::surrogate_pairs, 1);
+    }
+
+    inline void count_invalid_utf16()
+    {
+        utf8::internal::local_counters().add(statistics::invalid_utf16_errors, 1);
+    }
+
+    inline void count_replacement()
+    {
+        utf8::internal::local_counters().add(statistics::replacements, 1);
+    }
+
+    // The number of octets of word with the high bit set; the other bits
+    // do not matter
+    inline unsigned count_marked_octets(std::uint64_t word)
+    {
+        return static_cast<unsigned>((((word & 0x8080808080808080ull) >> 7) * 0x0101010101010101ull) >> 56);
+    }
+
+    // Counts the sequences of [first, last), valid UTF-8, by length; its
+    // four octet sequences are the surrogate pairs
+    template <typename octet_type>
+    void count_run(const octet_type* first, const octet_type* last, int kinds)
+    {
+        if (first == last)
+            return;
+        // Lead octets from 0xc0, 0xe0 and 0xf0 up, eight at a time: the
+        // high bit of each octet of c0 is set where the octet starts with
+        // 11, and so on
+        std::uint64_t ascii = 0, from_c0 = 0, from_e0 = 0, from_f0 = 0;
+        const std::uint64_t octets = static_cast<std::uint64_t>(last - first);
+        for (; last - first >= 8; first += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, first, 8);
+            const std::uint64_t c0 = word & (word << 1);
+            const std::uint64_t e0 = c0 & (word << 2);
+            ascii += utf8::internal::count_marked_octets(~word);
+            from_c0 += utf8::internal::count_marked_octets(c0);
+            from_e0 += utf8::internal::count_marked_octets(e0);
+            from_f0 += utf8::internal::count_marked_octets(e0 & (word << 3));
+        }
+        for (; first != last; ++first) {
+            const unsigned octet = static_cast<unsigned char>(*first);
+            ascii += octet < 0x80;
+            from_c0 += octet >= 0xc0;
+            from_e0 += octet >= 0xe0;
+            from_f0 += octet >= 0xf0;
+        }
+        const std::uint64_t lengths[4] = {ascii, from_c0 - from_e0, from_e0 - from_f0, from_f0};
+        thread_counters& counters = utf8::internal::local_counters();
+        if (kinds & run_decoded) {
+            counters.add(statistics::octets_decoded, octets);
+            for (int i = 0; i < 4; ++i)
+                counters.add(statistics::decoded_length_1 + i, lengths[i]);
+        }
+        if (kinds & run_encoded) {
+            counters.add(statistics::octets_encoded, octets);
+            for (int i = 0; i < 4; ++i)
+                counters.add(statistics::encoded_length_1 + i, lengths[i]);
+        }
+        if (kinds & run_surrogate_pairs)
+            counters.add(statistics::surrogate_pairs, lengths[3]);
+    }
+} // namespace internal
+
+    /// The counts of the calling thread
+    inline statistics thread_statistics()
+    {
+        statistics total = statistics();
+        utf8::internal::local_counters().add_to(total);
+        return total;
+    }
+
+    /// The counts of all threads
+    inline statistics collect_statistics()
+    {
+        utf8::internal::counter_registry& r = utf8::internal::registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        statistics total = r.ended;
+        for (std::size_t i = 0; i < r.running.size(); ++i)
+            r.running[i]->add_to(total);
+        return total;
+    }
+
+#else // #ifdef UTF8_CPP_INSTRUMENT
+
+namespace internal
+{
+    inline void count_decoded(unsigned) {}
+    inline void count_encoded(unsigned) {}
+    inline void count_error(int) {}
+    inline void count_surrogate_pair() {}
+    inline void count_invalid_utf16() {}
+    inline void count_replacement() {}
+    template <typename octet_type>
+    inline void count_run(const octet_type*, const octet_type*, int) {}
+} // namespace internal
+
+#endif // #ifdef UTF8_CPP_INSTRUMENT
+} // namespace utf8
+
+#endif // header guard
@@ -0,0 +1,276 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_PARALLEL_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_PARALLEL_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+#if !(__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#error "utf8/parallel.h requires C++11"
+#endif
+
+#include "checked.h"
+#include "unchecked.h"
+#include <exception>
+#include <numeric>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace utf8
+{
+namespace internal
+{
+    // With the thread count left to the library, no thread gets less than
+    // this many units; below it, starting a thread costs more than it saves
+    const std::size_t parallel_min_segment = 1 << 16;
+
+    inline unsigned segment_count(std::size_t size, unsigned threads)
+    {
+        std::size_t most = size;
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+            most = size / parallel_min_segment;
+        }
+        if (threads > most)
+            threads = static_cast<unsigned>(most);
+        return threads ? threads : 1;
+    }
+
+    // Cuts [start, end) into count segments of about the same size, moving
+    // each cut forward until at_boundary says a code point starts there
+    template <typename unit_iterator, typename boundary_test>
+    std::vector<unit_iterator> segment_cuts(unit_iterator start, unit_iterator end, unsigned count, boundary_test at_boundary)
+    {
+        std::vector<unit_iterator> cuts(1, start);
+        for (unsigned k = 1; k < count; ++k) {
+            unit_iterator cut = start + (end - start) / count * k;
+            if (cut < cuts.back())
+                cut = cuts.back();
+            while (cut != end && cut != start && !at_boundary(cut))
+                ++cut;
+            cuts.push_back(cut);
+        }
+        cuts.push_back(end);
+        return cuts;
+    }
+
+    template <typename octet_iterator>
+    std::vector<octet_iterator> utf8_cuts(octet_iterator start, octet_iterator end, unsigned count)
+    {
+        return utf8::internal::segment_cuts(start, end, count,
+            [](octet_iterator it) { return !utf8::internal::is_trail(*it); });
+    }
+
+    // A segment of UTF-16 ends neither inside a surrogate pair nor on a
+    // lead surrogate, so that it fails the way the whole range would
+    template <typename u16bit_iterator>
+    std::vector<u16bit_iterator> utf16_cuts(u16bit_iterator start, u16bit_iterator end, unsigned count)
+    {
+        return utf8::internal::segment_cuts(start, end, count,
+            [](u16bit_iterator it) {
+                return !utf8::internal::is_trail_surrogate(utf8::internal::mask16(*it)) &&
+                       !utf8::internal::is_lead_surrogate(utf8::internal::mask16(*(it - 1)));
+            });
+    }
+
+    // Runs task(k) for each segment k, the first one on the calling thread,
+    // and rethrows the exception of the earliest segment that threw
+    template <typename segment_task>
+    void run_segments(unsigned count, segment_task task)
+    {
+        std::vector<std::exception_ptr> errors(count);
+        auto run = [&](unsigned k) {
+            try {
+                task(k);
+            }
+            catch (...) {
+                errors[k] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> threads;
+        for (unsigned k = 1; k < count; ++k) {
+            try {
+                threads.push_back(std::thread(run, k));
+            }
+            catch (const std::system_error&) {
+                break;  // the segments left run here
+            }
+        }
+        for (unsigned k = static_cast<unsigned>(threads.size()) + 1; k < count; ++k)
+            run(k);
+        run(0);
+        for (std::size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+        for (unsigned k = 0; k < count; ++k)
+            if (errors[k])
+                std::rethrow_exception(errors[k]);
+    }
+
+    // Output offsets of the segments, from the length of each
+    template <typename length_type>
+    std::vector<length_type> segment_offsets(const std::vector<length_type>& lengths)
+    {
+        std::vector<length_type> offsets(lengths.size() + 1, 0);
+        std::partial_sum(lengths.begin(), lengths.end(), offsets.begin() + 1);
+        return offsets;
+    }
+
+    // The UTF-8 length pass. A sequence that a segment cuts off is followed
+    // by one that starts the next segment, so on the whole range it is
+    // invalid rather than incomplete.
+    template <typename octet_iterator, typename length_function>
+    std::vector<typename std::iterator_traits<octet_iterator>::difference_type>
+    utf8_segment_lengths(const std::vector<octet_iterator>& cuts, length_function length)
+    {
+        const unsigned count = static_cast<unsigned>(cuts.size() - 1);
+        std::vector<typename std::iterator_traits<octet_iterator>::difference_type> lengths(count);
+        utf8::internal::run_segments(count, [&](unsigned k) {
+            try {
+                lengths[k] = length(cuts[k], cuts[k + 1]);
+            }
+            catch (const not_enough_room&) {
+                if (cuts[k + 1] == cuts.back())
+                    throw;
+                throw invalid_utf8(utf8::internal::mask8(*utf8::find_invalid(cuts[k], cuts[k + 1])));
+            }
+        });
+        return lengths;
+    }
+} // namespace internal
+
+    // Versions of the functions that split a large range into segments at
+    // code point boundaries and run one thread on each. They need random
+    // access iterators, on the output too; raw pointers get the block paths
+    // as well. A thread count of zero leaves it to the library, which takes
+    // one thread for each processor core but keeps segments large; an
+    // explicit count is used as it is, as long as each segment gets a unit.
+    namespace parallel
+    {
+        template <typename octet_iterator>
+        octet_iterator find_invalid(octet_iterator start, octet_iterator end, unsigned threads = 0)
+        {
+            const unsigned count = utf8::internal::segment_count(end - start, threads);
+            if (count == 1)
+                return utf8::find_invalid(start, end);
+
+            // Segments before the first invalid one end on sequence
+            // boundaries, so its first invalid octet is that of the range
+            std::vector<octet_iterator> cuts = utf8::internal::utf8_cuts(start, end, count);
+            std::vector<octet_iterator> invalid(count);
+            utf8::internal::run_segments(count, [&](unsigned k) {
+                invalid[k] = utf8::find_invalid(cuts[k], cuts[k + 1]);
+            });
+            for (unsigned k = 0; k < count; ++k)
+                if (invalid[k] != cuts[k + 1])
+                    return invalid[k];
+            return end;
+        }
+
+        template <typename octet_iterator>
+        inline bool is_valid(octet_iterator start, octet_iterator end, unsigned threads = 0)
+        {
+            return (utf8::parallel::find_invalid(start, end, threads) == end);
+        }
+
+        // The conversions first take the length of each segment, which
+        // checks it, and then write all segments at their offsets at once.
+        // They throw what the plain conversions throw, but before writing.
+
+        template <typename u16bit_iterator, typename octet_iterator>
+        u16bit_iterator utf8to16(octet_iterator start, octet_iterator end, u16bit_iterator result, unsigned threads = 0)
+        {
+            const unsigned count = utf8::internal::segment_count(end - start, threads);
+            if (count == 1)
+                return utf8::utf8to16(start, end, result);
+
+            std::vector<octet_iterator> cuts = utf8::internal::utf8_cuts(start, end, count);
+            auto offsets = utf8::internal::segment_offsets(utf8::internal::utf8_segment_lengths(cuts,
+                [](octet_iterator first, octet_iterator last) { return utf8::utf8to16_length(first, last); }));
+            utf8::internal::run_segments(count, [&](unsigned k) {
+                utf8::unchecked::utf8to16(cuts[k], cuts[k + 1], result + offsets[k]);
+            });
+            return result + offsets[count];
+        }
+
+        template <typename octet_iterator, typename u32bit_iterator>
+        u32bit_iterator utf8to32(octet_iterator start, octet_iterator end, u32bit_iterator result, unsigned threads = 0)
+        {
+            const unsigned count = utf8::internal::segment_count(end - start, threads);
+            if (count == 1)
+                return utf8::utf8to32(start, end, result);
+
+            std::vector<octet_iterator> cuts = utf8::internal::utf8_cuts(start, end, count);
+            auto offsets = utf8::internal::segment_offsets(utf8::internal::utf8_segment_lengths(cuts,
+                [](octet_iterator first, octet_iterator last) { return utf8::utf8to32_length(first, last); }));
+            utf8::internal::run_segments(count, [&](unsigned k) {
+                utf8::unchecked::utf8to32(cuts[k], cuts[k + 1], result + offsets[k]);
+            });
+            return result + offsets[count];
+        }
+
+        template <typename u16bit_iterator, typename octet_iterator>
+        octet_iterator utf16to8(u16bit_iterator start, u16bit_iterator end, octet_iterator result, unsigned threads = 0)
+        {
+            const unsigned count = utf8::internal::segment_count(end - start, threads);
+            if (count == 1)
+                return utf8::utf16to8(start, end, result);
+
+            std::vector<u16bit_iterator> cuts = utf8::internal::utf16_cuts(start, end, count);
+            std::vector<typename std::iterator_traits<u16bit_iterator>::difference_type> lengths(count);
+            utf8::internal::run_segments(count, [&](unsigned k) {
+                lengths[k] = utf8::utf16to8_length(cuts[k], cuts[k + 1]);
+            });
+            auto offsets = utf8::internal::segment_offsets(lengths);
+            utf8::internal::run_segments(count, [&](unsigned k) {
+                utf8::unchecked::utf16to8(cuts[k], cuts[k + 1], result + offsets[k]);
+            });
+            return result + offsets[count];
+        }
+
+        template <typename octet_iterator, typename u32bit_iterator>
+        octet_iterator utf32to8(u32bit_iterator start, u32bit_iterator end, octet_iterator result, unsigned threads = 0)
+        {
+            const unsigned count = utf8::internal::segment_count(end - start, threads);
+            if (count == 1)
+                return utf8::utf32to8(start, end, result);
+
+            std::vector<u32bit_iterator> cuts = utf8::internal::segment_cuts(start, end, count,
+                [](u32bit_iterator) { return true; });
+            std::vector<typename std::iterator_traits<u32bit_iterator>::difference_type> lengths(count);
+            utf8::internal::run_segments(count, [&](unsigned k) {
+                lengths[k] = utf8::utf32to8_length(cuts[k], cuts[k + 1]);
+            });
+            auto offsets = utf8::internal::segment_offsets(lengths);
+            utf8::internal::run_segments(count, [&](unsigned k) {
+                utf8::unchecked::utf32to8(cuts[k], cuts[k + 1], result + offsets[k]);
+            });
+            return result + offsets[count];
+        }
+    } // namespace utf8::parallel
+} // namespace utf8
+
+#endif // header guard
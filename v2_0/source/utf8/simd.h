@@ -0,0 +1,1717 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_SIMD_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_SIMD_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+// Bulk kernels for contiguous (raw pointer) input. The library functions
+// use them transparently. Each kernel is compiled for its own instruction
+// set, whatever the compiler flags, and runs only when cpu.h has found
+// the processor to support it.
+
+#include "cpu.h"
+#include <cstddef>
+#include <cstring>
+
+#ifdef UTF8_CPP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define UTF8_CPP_TARGET_SSE2
+#define UTF8_CPP_TARGET_SSE42
+#define UTF8_CPP_TARGET_AVX2
+#define UTF8_CPP_TARGET_AVX512BW
+#else
+#ifdef __SSE2__
+#define UTF8_CPP_TARGET_SSE2
+#else
+#define UTF8_CPP_TARGET_SSE2     __attribute__((target("sse2")))
+#endif
+#define UTF8_CPP_TARGET_SSE42    __attribute__((target("sse4.2")))
+#define UTF8_CPP_TARGET_AVX2     __attribute__((target("avx2")))
+#define UTF8_CPP_TARGET_AVX512BW __attribute__((target("avx2,avx512bw")))
+#endif
+#endif // #ifdef UTF8_CPP_X86
+
+namespace utf8
+{
+    typedef unsigned char   uint8_t;
+    typedef unsigned short  uint16_t;
+    typedef unsigned int    uint32_t;
+
+// Helper code - not intended to be directly called by the library users. May be changed at any time
+namespace internal
+{
+    // For bit masks that cover 64 octets
+#if defined(_MSC_VER)
+    typedef unsigned __int64 uint64_t;
+#elif defined(__UINT64_TYPE__)
+    typedef __UINT64_TYPE__ uint64_t;
+#else
+    typedef unsigned long long uint64_t;
+#endif
+
+#ifdef UTF8_CPP_X86
+    // Index of the lowest set bit; mask must not be zero
+    inline unsigned lowest_bit(unsigned mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    inline unsigned lowest_bit(uint64_t mask)
+    {
+        const unsigned low = static_cast<unsigned>(mask);
+        return low ? utf8::internal::lowest_bit(low) : 32 + utf8::internal::lowest_bit(static_cast<unsigned>(mask >> 32));
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    // Word-at-a-time (SWAR) helpers for the scalar level and for the tails
+    // the vector kernels leave. Words are only tested as a whole, so that
+    // the byte order does not matter.
+    inline uint64_t load_word(const uint8_t* it)
+    {
+        uint64_t word;
+        std::memcpy(&word, it, sizeof(word));
+        return word;
+    }
+
+    // The high bit of every octet of a word
+    inline uint64_t high_bits()
+    {
+        const uint64_t low = 0x80808080u;
+        return low | (low << 32);
+    }
+
+    // The number of octets of word that have the high bit set; no other
+    // bits may be set
+    inline unsigned count_high_bits(uint64_t word)
+    {
+        const uint64_t ones = 0x01010101u;
+        return static_cast<unsigned>((((word >> 7) * (ones | (ones << 32))) >> 56) & 0xff);
+    }
+
+#ifdef UTF8_CPP_X86
+    // The ASCII scans stop at the first non-ASCII octet, or where less than
+    // a block is left
+    UTF8_CPP_TARGET_SSE2 inline const uint8_t* sse2_find_non_ascii(const uint8_t* it, const uint8_t* end)
+    {
+        for (; end - it >= 16; it += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(block));
+            if (mask)
+                return it + utf8::internal::lowest_bit(mask);
+        }
+        return it;
+    }
+
+    UTF8_CPP_TARGET_AVX2 inline const uint8_t* avx2_find_non_ascii(const uint8_t* it, const uint8_t* end)
+    {
+        for (; end - it >= 32; it += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(block));
+            if (mask)
+                return it + utf8::internal::lowest_bit(mask);
+        }
+        return utf8::internal::sse2_find_non_ascii(it, end);
+    }
+
+    UTF8_CPP_TARGET_AVX512BW inline const uint8_t* avx512bw_find_non_ascii(const uint8_t* it, const uint8_t* end)
+    {
+        for (; end - it >= 64; it += 64) {
+            __m512i block = _mm512_loadu_si512(reinterpret_cast<const void*>(it));
+            uint64_t mask = _mm512_movepi8_mask(block);
+            if (mask)
+                return it + utf8::internal::lowest_bit(mask);
+        }
+        return utf8::internal::avx2_find_non_ascii(it, end);
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    /// Returns the first octet in [it, end) that is not ASCII (or end)
+    inline const uint8_t* find_non_ascii(const uint8_t* it, const uint8_t* end)
+    {
+#ifdef UTF8_CPP_X86
+        switch (utf8::internal::active_simd_level()) {
+            case simd_avx512bw: it = utf8::internal::avx512bw_find_non_ascii(it, end); break;
+            case simd_avx2:     it = utf8::internal::avx2_find_non_ascii(it, end); break;
+            case simd_sse42:
+            case simd_sse2:     it = utf8::internal::sse2_find_non_ascii(it, end); break;
+            default:            break;
+        }
+#endif
+        for (; end - it >= 8; it += 8)
+            if (utf8::internal::load_word(it) & utf8::internal::high_bits())
+                break;
+        while (it != end && *it < 0x80)
+            ++it;
+        return it;
+    }
+
+#ifdef UTF8_CPP_X86
+    // Counting of the octets that start a sequence. Compared as signed
+    // values, the continuation octets 0x80-0xbf are the smallest ones. With
+    // pairs set, the lead octets 0xf0-0xff are counted once more, so that
+    // the count is in UTF-16 units. The per-octet counts are summed before
+    // they can overflow, every 255 (or 127) blocks.
+    template <bool pairs>
+    UTF8_CPP_TARGET_SSE2 inline std::ptrdiff_t sse2_count_units(const uint8_t*& it, const uint8_t* end)
+    {
+        const std::ptrdiff_t most = pairs ? 127 : 255;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i continuation_max = _mm_set1_epi8(static_cast<char>(0xbf));
+        const __m128i four_octets = _mm_set1_epi8(static_cast<char>(0xf0));
+        std::ptrdiff_t count = 0;
+        while (end - it >= 16) {
+            const std::ptrdiff_t blocks = (end - it) / 16 < most ? (end - it) / 16 : most;
+            const uint8_t* stop = it + 16 * blocks;
+            __m128i counts = zero;
+            for (; it != stop; it += 16) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+                counts = _mm_sub_epi8(counts, _mm_cmpgt_epi8(block, continuation_max));
+                if (pairs)
+                    counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(_mm_max_epu8(block, four_octets), block));
+            }
+            __m128i sums = _mm_sad_epu8(counts, zero);
+            count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+        }
+        return count;
+    }
+
+    template <bool pairs>
+    UTF8_CPP_TARGET_AVX2 inline std::ptrdiff_t avx2_count_units(const uint8_t*& it, const uint8_t* end)
+    {
+        const std::ptrdiff_t most = pairs ? 127 : 255;
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i continuation_max = _mm256_set1_epi8(static_cast<char>(0xbf));
+        const __m256i four_octets = _mm256_set1_epi8(static_cast<char>(0xf0));
+        std::ptrdiff_t count = 0;
+        while (end - it >= 32) {
+            const std::ptrdiff_t blocks = (end - it) / 32 < most ? (end - it) / 32 : most;
+            const uint8_t* stop = it + 32 * blocks;
+            __m256i counts = zero;
+            for (; it != stop; it += 32) {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+                counts = _mm256_sub_epi8(counts, _mm256_cmpgt_epi8(block, continuation_max));
+                if (pairs)
+                    counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(_mm256_max_epu8(block, four_octets), block));
+            }
+            __m256i sums = _mm256_sad_epu8(counts, zero);
+            __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            count += _mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(half, half));
+        }
+        return count + utf8::internal::sse2_count_units<pairs>(it, end);
+    }
+
+    template <bool pairs>
+    UTF8_CPP_TARGET_AVX512BW inline std::ptrdiff_t avx512bw_count_units(const uint8_t*& it, const uint8_t* end)
+    {
+        const std::ptrdiff_t most = pairs ? 127 : 255;
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i continuation_max = _mm512_set1_epi8(static_cast<char>(0xbf));
+        const __m512i four_octets = _mm512_set1_epi8(static_cast<char>(0xf0));
+        __m512i sums = zero;
+        while (end - it >= 64) {
+            const std::ptrdiff_t blocks = (end - it) / 64 < most ? (end - it) / 64 : most;
+            const uint8_t* stop = it + 64 * blocks;
+            __m512i counts = zero;
+            for (; it != stop; it += 64) {
+                __m512i block = _mm512_loadu_si512(reinterpret_cast<const void*>(it));
+                counts = _mm512_sub_epi8(counts, _mm512_movm_epi8(_mm512_cmpgt_epi8_mask(block, continuation_max)));
+                if (pairs)
+                    counts = _mm512_sub_epi8(counts, _mm512_movm_epi8(_mm512_cmpge_epu8_mask(block, four_octets)));
+            }
+            sums = _mm512_add_epi64(sums, _mm512_sad_epu8(counts, zero));
+        }
+        uint64_t lanes[8];
+        _mm512_storeu_si512(reinterpret_cast<void*>(lanes), sums);
+        std::ptrdiff_t count = 0;
+        for (int i = 0; i < 8; ++i)
+            count += static_cast<std::ptrdiff_t>(lanes[i]);
+        return count + utf8::internal::avx2_count_units<pairs>(it, end);
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    /// Returns the number of octets in [it, end) that are not continuation
+    /// octets, and with pairs set also the number of the 0xf0-0xff ones;
+    /// that is the number of code points (or of UTF-16 units) in valid UTF-8
+    template <bool pairs>
+    inline std::ptrdiff_t count_units(const uint8_t* it, const uint8_t* end)
+    {
+        std::ptrdiff_t count = 0;
+#ifdef UTF8_CPP_X86
+        switch (utf8::internal::active_simd_level()) {
+            case simd_avx512bw: count = utf8::internal::avx512bw_count_units<pairs>(it, end); break;
+            case simd_avx2:     count = utf8::internal::avx2_count_units<pairs>(it, end); break;
+            case simd_sse42:
+            case simd_sse2:     count = utf8::internal::sse2_count_units<pairs>(it, end); break;
+            default:            break;
+        }
+#endif
+        for (; end - it >= 8; it += 8) {
+            // 10xxxxxx: the high bit set, and the next one clear
+            const uint64_t word = utf8::internal::load_word(it);
+            count += 8 - utf8::internal::count_high_bits(word & ~(word << 1) & utf8::internal::high_bits());
+            // 1111xxxx: the four high bits set
+            if (pairs)
+                count += utf8::internal::count_high_bits(word & (word << 1) & (word << 2) & (word << 3) & utf8::internal::high_bits());
+        }
+        for (; it != end; ++it) {
+            if ((*it & 0xc0) != 0x80)
+                ++count;
+            if (pairs && *it >= 0xf0)
+                ++count;
+        }
+        return count;
+    }
+
+    inline std::ptrdiff_t count_code_points(const uint8_t* it, const uint8_t* end)
+    {
+        return utf8::internal::count_units<false>(it, end);
+    }
+
+#ifdef UTF8_CPP_X86
+    // The UTF-8 length of UTF-16 units: three octets per unit, less one
+    // for each unit below 0x80, below 0x800 and for each surrogate (a pair
+    // takes four). With validate set the kernel stops before the first
+    // block whose surrogates do not pair up, and never ends between the
+    // halves of a pair. The lane counts are summed every 8192 blocks.
+    UTF8_CPP_TARGET_SSE2 inline std::ptrdiff_t sse2_utf16to8_length(const uint16_t*& it, const uint16_t* end, bool validate)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i surrogate_bits = _mm_set1_epi16(static_cast<short>(0xf800));
+        const __m128i surrogate = _mm_set1_epi16(static_cast<short>(0xd800));
+        const __m128i pair_bits = _mm_set1_epi16(static_cast<short>(0xfc00));
+        const __m128i trail = _mm_set1_epi16(static_cast<short>(0xdc00));
+        const uint16_t* const first = it;
+        std::ptrdiff_t less = 0;
+        unsigned carry = 0; // the last unit so far is a lead surrogate
+        bool stopped = false;
+        while (!stopped && end - it >= 8) {
+            const std::ptrdiff_t blocks = (end - it) / 8 < 8192 ? (end - it) / 8 : 8192;
+            const uint16_t* stop = it + 8 * blocks;
+            __m128i counts = zero;
+            for (; it != stop; it += 8) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+                if (validate) {
+                    __m128i bits = _mm_and_si128(block, pair_bits);
+                    unsigned leads  = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(bits, surrogate)));
+                    unsigned trails = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(bits, trail)));
+                    if ((((leads << 2) | carry) & 0xffff) != trails) {
+                        stopped = true;
+                        break;
+                    }
+                    carry = leads >> 14;
+                }
+                counts = _mm_add_epi16(counts, _mm_cmpeq_epi16(_mm_srli_epi16(block, 7), zero));
+                counts = _mm_add_epi16(counts, _mm_cmpeq_epi16(_mm_srli_epi16(block, 11), zero));
+                counts = _mm_add_epi16(counts, _mm_cmpeq_epi16(_mm_and_si128(block, surrogate_bits), surrogate));
+            }
+            __m128i sums = _mm_madd_epi16(counts, ones);
+            sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, 0x4e));
+            sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, 0xb1));
+            less -= _mm_cvtsi128_si32(sums);
+        }
+        std::ptrdiff_t length = 3 * (it - first) - less;
+        if (carry) {
+            --it;
+            length -= 2;
+        }
+        return length;
+    }
+
+    // The UTF-8 length of UTF-32 values: one octet per value, plus one for
+    // each value above 0x7f, 0xfff and 0xffff, compared as unsigned values.
+    // With validate set the kernel stops before the first block that holds
+    // a surrogate or a value above 0x10ffff.
+    UTF8_CPP_TARGET_SSE2 inline std::ptrdiff_t sse2_utf32to8_length(const uint32_t*& it, const uint32_t* end, bool validate)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi32(static_cast<int>(0x80000000u));
+        const __m128i two_octets = _mm_set1_epi32(static_cast<int>(0x8000007fu));
+        const __m128i three_octets = _mm_set1_epi32(static_cast<int>(0x800007ffu));
+        const __m128i four_octets = _mm_set1_epi32(static_cast<int>(0x8000ffffu));
+        const __m128i code_point_max = _mm_set1_epi32(static_cast<int>(0x8010ffffu));
+        const __m128i surrogate_bits = _mm_set1_epi32(static_cast<int>(0xfffff800u));
+        const __m128i surrogate = _mm_set1_epi32(0xd800);
+        const uint32_t* const first = it;
+        std::ptrdiff_t more = 0;
+        bool stopped = false;
+        while (!stopped && end - it >= 4) {
+            const std::ptrdiff_t blocks = (end - it) / 4 < 65536 ? (end - it) / 4 : 65536;
+            const uint32_t* stop = it + 4 * blocks;
+            __m128i counts = zero;
+            for (; it != stop; it += 4) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+                __m128i biased = _mm_xor_si128(block, bias);
+                if (validate) {
+                    __m128i invalid = _mm_or_si128(_mm_cmpgt_epi32(biased, code_point_max),
+                            _mm_cmpeq_epi32(_mm_and_si128(block, surrogate_bits), surrogate));
+                    if (_mm_movemask_epi8(invalid)) {
+                        stopped = true;
+                        break;
+                    }
+                }
+                counts = _mm_sub_epi32(counts, _mm_cmpgt_epi32(biased, two_octets));
+                counts = _mm_sub_epi32(counts, _mm_cmpgt_epi32(biased, three_octets));
+                counts = _mm_sub_epi32(counts, _mm_cmpgt_epi32(biased, four_octets));
+            }
+            counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, 0x4e));
+            counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, 0xb1));
+            more += _mm_cvtsi128_si32(counts);
+        }
+        return (it - first) + more;
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    // Validation of whole blocks, after Keiser and Lemire, "Validating UTF-8
+    // In Less Than One Instruction Per Byte". Each octet is checked against
+    // its predecessor through three 16-entry nibble tables; every bit of the
+    // result stands for one kind of error that both octets agree on.
+    enum block_error {
+        BLOCK_TOO_SHORT      = 1 << 0, // 11______ 0_______ or 11______ 11______
+        BLOCK_TOO_LONG       = 1 << 1, // 0_______ 10______
+        BLOCK_OVERLONG_3     = 1 << 2, // 11100000 100_____
+        BLOCK_TOO_LARGE      = 1 << 3, // 11110100 1001____ or 11110100 101_____
+        BLOCK_SURROGATE      = 1 << 4, // 11101101 101_____
+        BLOCK_OVERLONG_2     = 1 << 5, // 1100000_ 10______
+        BLOCK_TOO_LARGE_1000 = 1 << 6, // 11110101 1000____ and above
+        BLOCK_OVERLONG_4     = 1 << 6, // 11110000 1000____
+        BLOCK_TWO_CONTS      = 1 << 7, // 10______ 10______
+        BLOCK_CARRY          = BLOCK_TOO_SHORT | BLOCK_TOO_LONG | BLOCK_TWO_CONTS
+    };
+
+    // Indexed by the high nibble of the first octet
+    const uint8_t block_byte_1_high[16] = {
+        // 0_______ ________ <ASCII in byte 1>
+        BLOCK_TOO_LONG, BLOCK_TOO_LONG, BLOCK_TOO_LONG, BLOCK_TOO_LONG,
+        BLOCK_TOO_LONG, BLOCK_TOO_LONG, BLOCK_TOO_LONG, BLOCK_TOO_LONG,
+        // 10______ ________ <continuation in byte 1>
+        BLOCK_TWO_CONTS, BLOCK_TWO_CONTS, BLOCK_TWO_CONTS, BLOCK_TWO_CONTS,
+        // 1100____ ________ <two octet lead in byte 1>
+        BLOCK_TOO_SHORT | BLOCK_OVERLONG_2,
+        // 1101____ ________ <two octet lead in byte 1>
+        BLOCK_TOO_SHORT,
+        // 1110____ ________ <three octet lead in byte 1>
+        BLOCK_TOO_SHORT | BLOCK_OVERLONG_3 | BLOCK_SURROGATE,
+        // 1111____ ________ <four octet lead in byte 1>
+        BLOCK_TOO_SHORT | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000 | BLOCK_OVERLONG_4
+    };
+
+    // Indexed by the low nibble of the first octet
+    const uint8_t block_byte_1_low[16] = {
+        // ____0000 ________
+        BLOCK_CARRY | BLOCK_OVERLONG_3 | BLOCK_OVERLONG_2 | BLOCK_OVERLONG_4,
+        // ____0001 ________
+        BLOCK_CARRY | BLOCK_OVERLONG_2,
+        // ____001_ ________
+        BLOCK_CARRY,
+        BLOCK_CARRY,
+        // ____0100 ________
+        BLOCK_CARRY | BLOCK_TOO_LARGE,
+        // ____0101 ________
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        // ____011_ ________
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        // ____1___ ________
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        // ____1101 ________
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000 | BLOCK_SURROGATE,
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000,
+        BLOCK_CARRY | BLOCK_TOO_LARGE | BLOCK_TOO_LARGE_1000
+    };
+
+    // Indexed by the high nibble of the second octet
+    const uint8_t block_byte_2_high[16] = {
+        // ________ 0_______ <ASCII in byte 2>
+        BLOCK_TOO_SHORT, BLOCK_TOO_SHORT, BLOCK_TOO_SHORT, BLOCK_TOO_SHORT,
+        BLOCK_TOO_SHORT, BLOCK_TOO_SHORT, BLOCK_TOO_SHORT, BLOCK_TOO_SHORT,
+        // ________ 1000____
+        BLOCK_TOO_LONG | BLOCK_OVERLONG_2 | BLOCK_TWO_CONTS | BLOCK_OVERLONG_3 | BLOCK_TOO_LARGE_1000 | BLOCK_OVERLONG_4,
+        // ________ 1001____
+        BLOCK_TOO_LONG | BLOCK_OVERLONG_2 | BLOCK_TWO_CONTS | BLOCK_OVERLONG_3 | BLOCK_TOO_LARGE,
+        // ________ 101_____
+        BLOCK_TOO_LONG | BLOCK_OVERLONG_2 | BLOCK_TWO_CONTS | BLOCK_SURROGATE | BLOCK_TOO_LARGE,
+        BLOCK_TOO_LONG | BLOCK_OVERLONG_2 | BLOCK_TWO_CONTS | BLOCK_SURROGATE | BLOCK_TOO_LARGE,
+        // ________ 11______
+        BLOCK_TOO_SHORT, BLOCK_TOO_SHORT, BLOCK_TOO_SHORT, BLOCK_TOO_SHORT
+    };
+
+    // A block ends inside a sequence if any octet exceeds its limit here
+    const uint8_t block_incomplete_max[32] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf
+    };
+
+    /// Steps back from a block boundary to the start of the sequence that
+    /// precedes it. Everything before the boundary must be valid except for
+    /// a possibly unfinished last sequence.
+    inline const uint8_t* sequence_start_before(const uint8_t* start, const uint8_t* it)
+    {
+        for (int i = 0; i < 4 && it != start; ++i)
+            if ((*--it & 0xc0) != 0x80)
+                break;
+        return it;
+    }
+
+#ifdef UTF8_CPP_X86
+    struct ssse3_validator {
+        __m128i byte_1_high, byte_1_low, byte_2_high, nibble;
+        __m128i incomplete_max, third_byte, fourth_byte, high_bit;
+
+        UTF8_CPP_TARGET_SSE42 ssse3_validator() :
+            byte_1_high(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block_byte_1_high))),
+            byte_1_low(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block_byte_1_low))),
+            byte_2_high(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block_byte_2_high))),
+            nibble(_mm_set1_epi8(0x0f)),
+            incomplete_max(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block_incomplete_max + 16))),
+            third_byte(_mm_set1_epi8(0xe0 - 0x80)),
+            fourth_byte(_mm_set1_epi8(0xf0 - 0x80)),
+            high_bit(_mm_set1_epi8(static_cast<char>(0x80)))
+        {}
+
+        UTF8_CPP_TARGET_SSE42 __m128i errors(__m128i input, __m128i prev_input) const
+        {
+            __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+            __m128i special = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                    _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+                _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+            // Third and fourth octets of a sequence must be continuations
+            __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+            __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+            __m128i must_be_continuation = _mm_and_si128(high_bit,
+                _mm_or_si128(_mm_subs_epu8(prev2, third_byte), _mm_subs_epu8(prev3, fourth_byte)));
+            return _mm_xor_si128(must_be_continuation, special);
+        }
+
+        UTF8_CPP_TARGET_SSE42 __m128i incomplete(__m128i input) const
+        {
+            return _mm_subs_epu8(input, incomplete_max);
+        }
+    };
+
+    UTF8_CPP_TARGET_SSE42 inline const uint8_t* ssse3_valid_prefix(const uint8_t* start, const uint8_t* end)
+    {
+        const ssse3_validator validator;
+        const __m128i zero = _mm_setzero_si128();
+        __m128i prev_input = zero, prev_incomplete = zero;
+        const uint8_t* it = start;
+        for (; end - it >= 16; it += 16) {
+            __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+            __m128i error;
+            if (_mm_movemask_epi8(input) == 0) {
+                error = prev_incomplete;
+                prev_incomplete = zero;
+            }
+            else {
+                error = validator.errors(input, prev_input);
+                prev_incomplete = validator.incomplete(input);
+            }
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xffff)
+                break;
+            prev_input = input;
+        }
+        return utf8::internal::sequence_start_before(start, it);
+    }
+
+    struct avx2_validator {
+        __m256i byte_1_high, byte_1_low, byte_2_high, nibble;
+        __m256i incomplete_max, third_byte, fourth_byte, high_bit;
+
+        UTF8_CPP_TARGET_AVX2 avx2_validator() :
+            byte_1_high(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block_byte_1_high)))),
+            byte_1_low(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block_byte_1_low)))),
+            byte_2_high(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block_byte_2_high)))),
+            nibble(_mm256_set1_epi8(0x0f)),
+            incomplete_max(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block_incomplete_max))),
+            third_byte(_mm256_set1_epi8(0xe0 - 0x80)),
+            fourth_byte(_mm256_set1_epi8(0xf0 - 0x80)),
+            high_bit(_mm256_set1_epi8(static_cast<char>(0x80)))
+        {}
+
+        UTF8_CPP_TARGET_AVX2 __m256i errors(__m256i input, __m256i prev_input) const
+        {
+            // Octets that precede the block come from the upper lane of prev_input
+            __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+            __m256i special = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                    _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+                _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+            __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+            __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+            __m256i must_be_continuation = _mm256_and_si256(high_bit,
+                _mm256_or_si256(_mm256_subs_epu8(prev2, third_byte), _mm256_subs_epu8(prev3, fourth_byte)));
+            return _mm256_xor_si256(must_be_continuation, special);
+        }
+
+        UTF8_CPP_TARGET_AVX2 __m256i incomplete(__m256i input) const
+        {
+            return _mm256_subs_epu8(input, incomplete_max);
+        }
+    };
+
+    UTF8_CPP_TARGET_AVX2 inline const uint8_t* avx2_valid_prefix(const uint8_t* start, const uint8_t* end)
+    {
+        const avx2_validator validator;
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i prev_input = zero, prev_incomplete = zero;
+        const uint8_t* it = start;
+        for (; end - it >= 32; it += 32) {
+            __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+            __m256i error;
+            if (_mm256_movemask_epi8(input) == 0) {
+                error = prev_incomplete;
+                prev_incomplete = zero;
+            }
+            else {
+                error = validator.errors(input, prev_input);
+                prev_incomplete = validator.incomplete(input);
+            }
+            if (!_mm256_testz_si256(error, error))
+                break;
+            prev_input = input;
+        }
+        return utf8::internal::sequence_start_before(start, it);
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    /// As sequence_start_before, for a boundary before which count units
+    /// were counted (as by count_units); takes the sequence stepped over off
+    /// the count
+    template <bool pairs>
+    inline const uint8_t* counted_sequence_start_before(const uint8_t* start, const uint8_t* it, std::ptrdiff_t& count)
+    {
+        const uint8_t* sequence_start = utf8::internal::sequence_start_before(start, it);
+        if (sequence_start != it)
+            count -= (pairs && *sequence_start >= 0xf0) ? 2 : 1;
+        return sequence_start;
+    }
+
+#ifdef UTF8_CPP_X86
+    // Validation fused with counting: each block is counted, as in
+    // sse2_count_units, once it has passed the checks of ssse3_valid_prefix,
+    // so that the input is read once rather than twice
+    template <bool pairs>
+    UTF8_CPP_TARGET_SSE42 inline const uint8_t* ssse3_valid_count(const uint8_t* start, const uint8_t* end, std::ptrdiff_t& count)
+    {
+        const ssse3_validator validator;
+        const std::ptrdiff_t most = pairs ? 127 : 255;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i continuation_max = _mm_set1_epi8(static_cast<char>(0xbf));
+        const __m128i four_octets = _mm_set1_epi8(static_cast<char>(0xf0));
+        __m128i prev_input = zero, prev_incomplete = zero;
+        const uint8_t* it = start;
+        bool stopped = false;
+        count = 0;
+        while (!stopped && end - it >= 16) {
+            const std::ptrdiff_t blocks = (end - it) / 16 < most ? (end - it) / 16 : most;
+            const uint8_t* stop = it + 16 * blocks;
+            __m128i counts = zero;
+            for (; it != stop; it += 16) {
+                __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+                __m128i error;
+                if (_mm_movemask_epi8(input) == 0) {
+                    error = prev_incomplete;
+                    prev_incomplete = zero;
+                }
+                else {
+                    error = validator.errors(input, prev_input);
+                    prev_incomplete = validator.incomplete(input);
+                }
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xffff) {
+                    stopped = true;
+                    break;
+                }
+                prev_input = input;
+                counts = _mm_sub_epi8(counts, _mm_cmpgt_epi8(input, continuation_max));
+                if (pairs)
+                    counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(_mm_max_epu8(input, four_octets), input));
+            }
+            __m128i sums = _mm_sad_epu8(counts, zero);
+            count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+        }
+        return utf8::internal::counted_sequence_start_before<pairs>(start, it, count);
+    }
+
+    template <bool pairs>
+    UTF8_CPP_TARGET_AVX2 inline const uint8_t* avx2_valid_count(const uint8_t* start, const uint8_t* end, std::ptrdiff_t& count)
+    {
+        const avx2_validator validator;
+        const std::ptrdiff_t most = pairs ? 127 : 255;
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i continuation_max = _mm256_set1_epi8(static_cast<char>(0xbf));
+        const __m256i four_octets = _mm256_set1_epi8(static_cast<char>(0xf0));
+        __m256i prev_input = zero, prev_incomplete = zero;
+        const uint8_t* it = start;
+        bool stopped = false;
+        count = 0;
+        while (!stopped && end - it >= 32) {
+            const std::ptrdiff_t blocks = (end - it) / 32 < most ? (end - it) / 32 : most;
+            const uint8_t* stop = it + 32 * blocks;
+            __m256i counts = zero;
+            for (; it != stop; it += 32) {
+                __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+                __m256i error;
+                if (_mm256_movemask_epi8(input) == 0) {
+                    error = prev_incomplete;
+                    prev_incomplete = zero;
+                }
+                else {
+                    error = validator.errors(input, prev_input);
+                    prev_incomplete = validator.incomplete(input);
+                }
+                if (!_mm256_testz_si256(error, error)) {
+                    stopped = true;
+                    break;
+                }
+                prev_input = input;
+                counts = _mm256_sub_epi8(counts, _mm256_cmpgt_epi8(input, continuation_max));
+                if (pairs)
+                    counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(_mm256_max_epu8(input, four_octets), input));
+            }
+            __m256i sums = _mm256_sad_epu8(counts, zero);
+            __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            count += _mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(half, half));
+        }
+        return utf8::internal::counted_sequence_start_before<pairs>(start, it, count);
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    /// Returns a sequence boundary p such that [start, p) is valid UTF-8.
+    /// The first invalid sequence, if any, begins within a block's length of
+    /// p; the rest of the input is left for the scalar decoder to pin down.
+    inline const uint8_t* valid_prefix(const uint8_t* start, const uint8_t* end)
+    {
+#ifdef UTF8_CPP_X86
+        const simd_level level = utf8::internal::active_simd_level();
+        if (level >= simd_avx2)
+            return utf8::internal::avx2_valid_prefix(start, end);
+        if (level >= simd_sse42)
+            return utf8::internal::ssse3_valid_prefix(start, end);
+#endif
+        (void)end;
+        return start;
+    }
+
+    /// valid_prefix and count_units in one pass: returns the same boundary
+    /// as valid_prefix, and sets count to the units before it
+    template <bool pairs>
+    inline const uint8_t* valid_count(const uint8_t* start, const uint8_t* end, std::ptrdiff_t& count)
+    {
+#ifdef UTF8_CPP_X86
+        const simd_level level = utf8::internal::active_simd_level();
+        if (level >= simd_avx2)
+            return utf8::internal::avx2_valid_count<pairs>(start, end, count);
+        if (level >= simd_sse42)
+            return utf8::internal::ssse3_valid_count<pairs>(start, end, count);
+#endif
+        (void)end;
+        count = 0;
+        return start;
+    }
+
+    /// Moves it forward by most of n code points, but fewer than n, and
+    /// returns how many; it stays on a sequence boundary. With validate set
+    /// it only moves over valid UTF-8 in [it, end). Otherwise end is not
+    /// used: the input is taken to be valid and to hold n code points, and
+    /// so at least n octets.
+    inline std::ptrdiff_t skip_code_points(const uint8_t*& it, const uint8_t* end, std::ptrdiff_t n, bool validate)
+    {
+        // A span holds at most as many code points as octets, so that one of
+        // an octet fewer than the code points left never goes too far
+        std::ptrdiff_t left = n;
+        while (left > 64) {
+            const uint8_t* span_end = validate && end - it < left - 1 ? end : it + (left - 1);
+            std::ptrdiff_t count = 0;
+            if (validate) {
+                const uint8_t* valid_end = utf8::internal::valid_count<false>(it, span_end, count);
+                // stopped by an invalid sequence or by the end; the callers
+                // take it from there
+                if (valid_end == it)
+                    break;
+                it = valid_end;
+            }
+            else {
+                count = utf8::internal::count_code_points(it, span_end);
+                it = utf8::internal::counted_sequence_start_before<false>(it, span_end, count);
+            }
+            left -= count;
+        }
+        return n - left;
+    }
+
+    // Selects the code for the width of the output units
+    template <int size>
+    struct unit_size {};
+
+#ifdef UTF8_CPP_X86
+    // Shuffle tables for decoding blocks of UTF-8. The first 12 octets of a
+    // block are described by a mask with bit i set when octet i ends a code
+    // point, and the mask selects one of three layouts:
+    //   entries   0 -  63: six code points of 1-2 octets in 16-bit lanes
+    //   entries  64 - 144: four code points of 1-3 octets in 32-bit lanes
+    //   entries 145 - 208: three code points of 1-4 octets in 32-bit lanes
+    // Each entry gathers the octets of a code point into its lane, last
+    // octet first, and masks off the length bits. The tables are built on
+    // first use.
+    struct utf8_block_tables {
+        enum { NO_ENTRY = 0xff, TWO_OCTETS = 0, THREE_OCTETS = 64, FOUR_OCTETS = 145, ENTRIES = 209 };
+
+        // Entry number in the low octet, octets consumed in the high one
+        uint16_t entry[4096];
+        uint8_t shuffle[ENTRIES][16];
+        uint8_t mask[ENTRIES][16];
+
+        utf8_block_tables()
+        {
+            for (unsigned end_mask = 0; end_mask < 4096; ++end_mask) {
+                unsigned lengths[12], count = 0, start = 0;
+                for (unsigned i = 0; i < 12; ++i)
+                    if (end_mask & (1u << i)) {
+                        lengths[count++] = i + 1 - start;
+                        start = i + 1;
+                    }
+
+                if (fits(lengths, count, 6, 2))
+                    entry[end_mask] = add_entry(TWO_OCTETS, lengths, 6, 2, 2);
+                else if (fits(lengths, count, 4, 3))
+                    entry[end_mask] = add_entry(THREE_OCTETS, lengths, 4, 3, 4);
+                else if (fits(lengths, count, 3, 4))
+                    entry[end_mask] = add_entry(FOUR_OCTETS, lengths, 3, 4, 4);
+                else
+                    entry[end_mask] = NO_ENTRY;
+            }
+        }
+
+        static bool fits(const unsigned* lengths, unsigned count, unsigned code_points, unsigned max_length)
+        {
+            if (count < code_points)
+                return false;
+            for (unsigned i = 0; i < code_points; ++i)
+                if (lengths[i] > max_length)
+                    return false;
+            return true;
+        }
+
+        // Within a layout, entries are numbered by the lengths in base max_length
+        uint16_t add_entry(unsigned first, const unsigned* lengths, unsigned code_points,
+                           unsigned max_length, unsigned lane_size)
+        {
+            unsigned index = 0;
+            for (unsigned i = code_points; i-- > 0;)
+                index = index * max_length + lengths[i] - 1;
+            index += first;
+
+            for (unsigned k = 0; k < 16; ++k) {
+                shuffle[index][k] = 0x80; // zeroes the octet
+                mask[index][k] = 0;
+            }
+            unsigned start = 0;
+            for (unsigned i = 0; i < code_points; ++i) {
+                const unsigned length = lengths[i];
+                for (unsigned k = 0; k < length; ++k) {
+                    shuffle[index][i * lane_size + k] = static_cast<uint8_t>(start + length - 1 - k);
+                    if (k == length - 1)
+                        mask[index][i * lane_size + k] = static_cast<uint8_t>(length == 1 ? 0x7f : 0xff >> (length + 1));
+                    else
+                        mask[index][i * lane_size + k] = 0x3f;
+                }
+                start += length;
+            }
+            return static_cast<uint16_t>(index | (start << 8));
+        }
+    };
+
+    inline const utf8_block_tables& block_tables()
+    {
+        static const utf8_block_tables tables;
+        return tables;
+    }
+
+    struct ssse3_utf8_decoder {
+        const utf8_block_tables& tables;
+        __m128i zero, lead_min, low_octet16, high_octet16, octet0, octet1, octet2, octet3, pack32;
+
+        UTF8_CPP_TARGET_SSE42 ssse3_utf8_decoder() :
+            tables(utf8::internal::block_tables()),
+            zero(_mm_setzero_si128()),
+            lead_min(_mm_set1_epi8(static_cast<char>(0xc0))),
+            low_octet16(_mm_set1_epi16(0x00ff)),
+            high_octet16(_mm_set1_epi16(static_cast<short>(0xff00))),
+            octet0(_mm_set1_epi32(0x000000ff)),
+            octet1(_mm_set1_epi32(0x0000ff00)),
+            octet2(_mm_set1_epi32(0x00ff0000)),
+            octet3(_mm_set1_epi32(static_cast<int>(0xff000000))),
+            pack32(_mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1))
+        {}
+
+        // Bit i is set when octet i of the block is a continuation octet
+        UTF8_CPP_TARGET_SSE42 unsigned continuation(__m128i input) const
+        {
+            return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmplt_epi8(input, lead_min)));
+        }
+
+        // Gathers the code points selected by the entry into their lanes
+        UTF8_CPP_TARGET_SSE42 __m128i gather(__m128i input, unsigned index) const
+        {
+            return _mm_and_si128(
+                _mm_shuffle_epi8(input, _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffle[index]))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.mask[index])));
+        }
+
+        UTF8_CPP_TARGET_SSE42 __m128i code_points(__m128i lanes) const
+        {
+            return _mm_or_si128(
+                _mm_or_si128(_mm_and_si128(lanes, octet0), _mm_srli_epi32(_mm_and_si128(lanes, octet1), 2)),
+                _mm_or_si128(_mm_srli_epi32(_mm_and_si128(lanes, octet2), 4), _mm_srli_epi32(_mm_and_si128(lanes, octet3), 6)));
+        }
+
+        UTF8_CPP_TARGET_SSE42 __m128i code_units(__m128i lanes) const
+        {
+            return _mm_or_si128(_mm_and_si128(lanes, low_octet16), _mm_srli_epi16(_mm_and_si128(lanes, high_octet16), 2));
+        }
+
+        /// Decodes the code points at the start of the block described by
+        /// end_mask. Returns the number of octets consumed, or 0 when the
+        /// octets do not form a layout (possible only with invalid input).
+        template <typename u16_type>
+        UTF8_CPP_TARGET_SSE42 unsigned decode(__m128i input, unsigned end_mask, u16_type*& out, unit_size<2>) const
+        {
+            const unsigned entry = tables.entry[end_mask & 0xfff];
+            const unsigned index = entry & 0xff;
+            if (index == utf8_block_tables::NO_ENTRY)
+                return 0;
+
+            __m128i lanes = gather(input, index);
+            if (index < utf8_block_tables::THREE_OCTETS) {
+                __m128i units = code_units(lanes);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out), units);
+                out[4] = static_cast<u16_type>(_mm_extract_epi16(units, 4));
+                out[5] = static_cast<u16_type>(_mm_extract_epi16(units, 5));
+                out += 6;
+            }
+            else if (index < utf8_block_tables::FOUR_OCTETS) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(code_points(lanes), pack32));
+                out += 4;
+            }
+            else {
+                uint32_t cp[4];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(cp), code_points(lanes));
+                for (int i = 0; i < 3; ++i) {
+                    if (cp[i] > 0xffff) { // make a surrogate pair
+                        *out++ = static_cast<u16_type>((cp[i] >> 10) + (0xd800 - (0x10000 >> 10)));
+                        *out++ = static_cast<u16_type>((cp[i] & 0x3ff) + 0xdc00);
+                    }
+                    else
+                        *out++ = static_cast<u16_type>(cp[i]);
+                }
+            }
+            return entry >> 8;
+        }
+
+        template <typename u32_type>
+        UTF8_CPP_TARGET_SSE42 unsigned decode(__m128i input, unsigned end_mask, u32_type*& out, unit_size<4>) const
+        {
+            const unsigned entry = tables.entry[end_mask & 0xfff];
+            const unsigned index = entry & 0xff;
+            if (index == utf8_block_tables::NO_ENTRY)
+                return 0;
+
+            __m128i lanes = gather(input, index);
+            if (index < utf8_block_tables::THREE_OCTETS) {
+                __m128i units = code_units(lanes);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(units, zero));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(units, zero));
+                out += 6;
+            }
+            else if (index < utf8_block_tables::FOUR_OCTETS) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), code_points(lanes));
+                out += 4;
+            }
+            else {
+                __m128i cp = code_points(lanes);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out), cp);
+                out[2] = static_cast<u32_type>(_mm_cvtsi128_si32(_mm_srli_si128(cp, 8)));
+                out += 3;
+            }
+            return entry >> 8;
+        }
+
+        // Widens 16 ASCII octets
+        template <typename u16_type>
+        UTF8_CPP_TARGET_SSE42 void widen(__m128i input, u16_type*& out, unit_size<2>) const
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(input, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpackhi_epi8(input, zero));
+            out += 16;
+        }
+
+        template <typename u32_type>
+        UTF8_CPP_TARGET_SSE42 void widen(__m128i input, u32_type*& out, unit_size<4>) const
+        {
+            __m128i low = _mm_unpacklo_epi8(input, zero), high = _mm_unpackhi_epi8(input, zero);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(low, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(low, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(high, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(high, zero));
+            out += 16;
+        }
+    };
+
+    /// Decodes UTF-8 into UTF-16 or UTF-32 a block at a time while at least
+    /// 16 octets remain. The input must be valid; it and result are left at
+    /// the first octet and unit that were not converted.
+    template <typename unit_type>
+    UTF8_CPP_TARGET_SSE42 void ssse3_decode_utf8(const uint8_t*& it, const uint8_t* end, unit_type*& result)
+    {
+        const ssse3_utf8_decoder decoder;
+        const unit_size<sizeof(unit_type)> size;
+        const uint8_t* in = it;
+        unit_type* out = result;
+
+        // Classify 64 octets at a time, so that finding the next block is a
+        // shift of the masks rather than a round trip through the vectors
+        while (end - in >= 64) {
+            uint64_t non_ascii = 0, continuation = 0;
+            for (int k = 0; k < 4; ++k) {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16 * k));
+                non_ascii |= static_cast<uint64_t>(_mm_movemask_epi8(block)) << (16 * k);
+                continuation |= static_cast<uint64_t>(decoder.continuation(block)) << (16 * k);
+            }
+            if (non_ascii == 0) {
+                for (int k = 0; k < 4; ++k)
+                    decoder.widen(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16 * k)), out, size);
+                in += 64;
+                continue;
+            }
+
+            const uint64_t ends = ~continuation >> 1;
+            unsigned pos = 0;
+            while (pos <= 48) {
+                __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos));
+                if (((non_ascii >> pos) & 0xffff) == 0) {
+                    decoder.widen(input, out, size);
+                    pos += 16;
+                    continue;
+                }
+                unsigned consumed = decoder.decode(input, static_cast<unsigned>(ends >> pos), out, size);
+                if (consumed == 0) {
+                    it = in + pos;
+                    result = out;
+                    return;
+                }
+                pos += consumed;
+            }
+            in += pos;
+        }
+
+        while (end - in >= 16) {
+            __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+            unsigned consumed = decoder.decode(input, ~decoder.continuation(input) >> 1, out, size);
+            if (consumed == 0)
+                break;
+            in += consumed;
+        }
+        it = in;
+        result = out;
+    }
+
+    // Compaction tables for encoding blocks of UTF-16 and UTF-32. The octets
+    // of each code point are first laid out in a fixed-size lane; the
+    // shuffle then squeezes out the unused octets.
+    //   pack12:   eight 16-bit lanes of 1-2 octets, keyed by the mask of
+    //             lanes that hold ASCII
+    //   pack123:  four 32-bit lanes of 1-3 octets, keyed by the mask of
+    //             ASCII lanes in the low nibble and of lanes below 0x800 in
+    //             the high nibble
+    //   pack1234: four 32-bit lanes of 1-4 octets, keyed by the low bit of
+    //             each lane's length - 1 in the low nibble and the high bit
+    //             in the high nibble
+    struct encode_block_tables {
+        uint8_t pack12[256][16];
+        uint8_t pack12_length[256];
+        uint8_t pack123[256][16];
+        uint8_t pack123_length[256];
+        uint8_t pack1234[256][16];
+        uint8_t pack1234_length[256];
+
+        encode_block_tables()
+        {
+            for (unsigned key = 0; key < 256; ++key) {
+                unsigned length = 0;
+                for (unsigned i = 0; i < 8; ++i) {
+                    pack12[key][length++] = static_cast<uint8_t>(2 * i);
+                    if (!(key & (1u << i)))
+                        pack12[key][length++] = static_cast<uint8_t>(2 * i + 1);
+                }
+                pack12_length[key] = static_cast<uint8_t>(length);
+                while (length < 16)
+                    pack12[key][length++] = 0x80;
+
+                length = 0;
+                for (unsigned i = 0; i < 4; ++i) {
+                    unsigned octets = (key & (1u << i)) ? 1 : (key & (0x10u << i)) ? 2 : 3;
+                    for (unsigned k = 0; k < octets; ++k)
+                        pack123[key][length++] = static_cast<uint8_t>(4 * i + k);
+                }
+                pack123_length[key] = static_cast<uint8_t>(length);
+                while (length < 16)
+                    pack123[key][length++] = 0x80;
+
+                length = 0;
+                for (unsigned i = 0; i < 4; ++i) {
+                    unsigned octets = 1 + ((key >> i) & 1) + ((key >> (3 + i)) & 2);
+                    for (unsigned k = 0; k < octets; ++k)
+                        pack1234[key][length++] = static_cast<uint8_t>(4 * i + k);
+                }
+                pack1234_length[key] = static_cast<uint8_t>(length);
+                while (length < 16)
+                    pack1234[key][length++] = 0x80;
+            }
+        }
+    };
+
+    inline const encode_block_tables& encode_tables()
+    {
+        static const encode_block_tables tables;
+        return tables;
+    }
+
+    template <typename octet_type>
+    inline void write_utf8(uint32_t cp, octet_type*& out)
+    {
+        if (cp < 0x80)
+            *out++ = static_cast<octet_type>(cp);
+        else if (cp < 0x800) {
+            *out++ = static_cast<octet_type>((cp >> 6)          | 0xc0);
+            *out++ = static_cast<octet_type>((cp & 0x3f)        | 0x80);
+        }
+        else if (cp < 0x10000) {
+            *out++ = static_cast<octet_type>((cp >> 12)         | 0xe0);
+            *out++ = static_cast<octet_type>(((cp >> 6) & 0x3f) | 0x80);
+            *out++ = static_cast<octet_type>((cp & 0x3f)        | 0x80);
+        }
+        else {
+            *out++ = static_cast<octet_type>((cp >> 18)         | 0xf0);
+            *out++ = static_cast<octet_type>(((cp >> 12) & 0x3f)| 0x80);
+            *out++ = static_cast<octet_type>(((cp >> 6) & 0x3f) | 0x80);
+            *out++ = static_cast<octet_type>((cp & 0x3f)        | 0x80);
+        }
+    }
+
+    /// Encodes UTF-16 into UTF-8 eight units at a time. Blocks without
+    /// surrogates are encoded in registers, blocks with surrogates one unit
+    /// at a time. Stops at a lone surrogate, or when fewer than 24 units
+    /// remain (the block stores run up to 12 octets ahead of the output).
+    template <typename u16_type, typename octet_type>
+    UTF8_CPP_TARGET_SSE42 void ssse3_utf16to8(u16_type*& it, u16_type* end, octet_type*& result)
+    {
+        const encode_block_tables& tables = utf8::internal::encode_tables();
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i non_ascii16 = _mm_set1_epi16(static_cast<short>(0xff80));
+        const __m128i three_octets16 = _mm_set1_epi16(static_cast<short>(0xf800));
+        const __m128i surrogate16 = _mm_set1_epi16(static_cast<short>(0xd800));
+        const __m128i two_octet_tags16 = _mm_set1_epi16(static_cast<short>(0x80c0));
+        const __m128i low6_16 = _mm_set1_epi16(0x3f);
+        const __m128i ascii_max32 = _mm_set1_epi32(0x80);
+        const __m128i two_octets_max32 = _mm_set1_epi32(0x800);
+        const __m128i low6_32 = _mm_set1_epi32(0x3f);
+        const __m128i two_octet_tags32 = _mm_set1_epi32(0x80c0);
+        const __m128i three_octet_tags32 = _mm_set1_epi32(0x8080e0);
+
+        u16_type* in = it;
+        octet_type* out = result;
+        while (end - in >= 24) {
+            __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+
+            unsigned surrogates = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_cmpeq_epi16(_mm_and_si128(units, three_octets16), surrogate16)));
+            if (surrogates) {
+                // A pair may end one unit past the block
+                u16_type* block_end = in + 8;
+                while (in < block_end) {
+                    uint32_t cp = static_cast<uint32_t>(*in) & 0xffff;
+                    if (cp >= 0xd800 && cp <= 0xdfff) {
+                        uint32_t trail = static_cast<uint32_t>(in[1]) & 0xffff;
+                        if (cp > 0xdbff || trail < 0xdc00 || trail > 0xdfff) {
+                            it = in; // lone surrogate
+                            result = out;
+                            return;
+                        }
+                        cp = (cp << 10) + trail + (0x10000u - (0xd800u << 10) - 0xdc00u);
+                        ++in;
+                    }
+                    utf8::internal::write_utf8(cp, out);
+                    ++in;
+                }
+                continue;
+            }
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, non_ascii16), zero)) == 0xffff) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(units, units));
+                in += 8;
+                out += 8;
+                continue;
+            }
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, three_octets16), zero)) == 0xffff) {
+                // 110yyyyy 10xxxxxx in every lane; ASCII lanes keep their single octet
+                __m128i is_ascii = _mm_cmpeq_epi16(_mm_and_si128(units, non_ascii16), zero);
+                __m128i two = _mm_or_si128(_mm_or_si128(_mm_srli_epi16(units, 6), two_octet_tags16),
+                                           _mm_slli_epi16(_mm_and_si128(units, low6_16), 8));
+                __m128i lanes = _mm_or_si128(_mm_and_si128(is_ascii, units), _mm_andnot_si128(is_ascii, two));
+                unsigned key = static_cast<unsigned>(_mm_movemask_epi8(_mm_packs_epi16(is_ascii, zero)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(lanes,
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.pack12[key]))));
+                in += 8;
+                out += tables.pack12_length[key];
+                continue;
+            }
+
+            for (int half = 0; half < 2; ++half) {
+                __m128i cp = half ? _mm_unpackhi_epi16(units, zero) : _mm_unpacklo_epi16(units, zero);
+                __m128i is_ascii = _mm_cmplt_epi32(cp, ascii_max32);
+                __m128i is_two = _mm_cmplt_epi32(cp, two_octets_max32);
+                __m128i two = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(cp, 6), two_octet_tags32),
+                                           _mm_slli_epi32(_mm_and_si128(cp, low6_32), 8));
+                __m128i three = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(cp, 12), three_octet_tags32),
+                                             _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(cp, 6), low6_32), 8),
+                                                          _mm_slli_epi32(_mm_and_si128(cp, low6_32), 16)));
+                __m128i lanes = _mm_or_si128(_mm_and_si128(is_ascii, cp),
+                    _mm_andnot_si128(is_ascii, _mm_or_si128(_mm_and_si128(is_two, two), _mm_andnot_si128(is_two, three))));
+                unsigned key = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(is_ascii))) |
+                               static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(is_two))) << 4;
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(lanes,
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.pack123[key]))));
+                out += tables.pack123_length[key];
+            }
+            in += 8;
+        }
+        it = in;
+        result = out;
+    }
+
+    /// Encodes UTF-32 into UTF-8 four code points at a time, sixteen when
+    /// they are all ASCII. Stops at a value above 0x10FFFF, at a surrogate
+    /// when validate is set, or when fewer than 16 units remain.
+    template <typename u32_type, typename octet_type>
+    UTF8_CPP_TARGET_SSE42 void ssse3_utf32to8(u32_type*& it, u32_type* end, octet_type*& result, bool validate)
+    {
+        const encode_block_tables& tables = utf8::internal::encode_tables();
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i non_ascii32 = _mm_set1_epi32(static_cast<int>(0xffffff80));
+        const __m128i sign32 = _mm_set1_epi32(static_cast<int>(0x80000000));
+        const __m128i code_point_max32 = _mm_set1_epi32(static_cast<int>(0x8010ffff));
+        const __m128i surrogate_mask32 = _mm_set1_epi32(static_cast<int>(0xfffff800));
+        const __m128i surrogate32 = _mm_set1_epi32(0xd800);
+        const __m128i ascii_max32 = _mm_set1_epi32(0x80);
+        const __m128i two_octets_max32 = _mm_set1_epi32(0x800);
+        const __m128i three_octets_max32 = _mm_set1_epi32(0x10000);
+        const __m128i three32 = _mm_set1_epi32(3);
+        const __m128i low6_32 = _mm_set1_epi32(0x3f);
+        const __m128i two_octet_tags32 = _mm_set1_epi32(0x80c0);
+        const __m128i three_octet_tags32 = _mm_set1_epi32(0x8080e0);
+        const __m128i four_octet_tags32 = _mm_set1_epi32(static_cast<int>(0x808080f0));
+
+        u32_type* in = it;
+        octet_type* out = result;
+        while (end - in >= 16) {
+            const __m128i* block = reinterpret_cast<const __m128i*>(in);
+            __m128i a = _mm_loadu_si128(block), b = _mm_loadu_si128(block + 1),
+                    c = _mm_loadu_si128(block + 2), d = _mm_loadu_si128(block + 3);
+            __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, non_ascii32), zero)) == 0xffff) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                                 _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+                in += 16;
+                out += 16;
+                continue;
+            }
+
+            __m128i cp = a;
+            __m128i invalid = _mm_cmpgt_epi32(_mm_xor_si128(cp, sign32), code_point_max32);
+            if (validate)
+                invalid = _mm_or_si128(invalid, _mm_cmpeq_epi32(_mm_and_si128(cp, surrogate_mask32), surrogate32));
+            if (_mm_movemask_epi8(invalid))
+                break;
+
+            // Every lane is at most 0x10FFFF, so the signed compares hold
+            __m128i is_ascii = _mm_cmplt_epi32(cp, ascii_max32);
+            __m128i is_two = _mm_cmplt_epi32(cp, two_octets_max32);
+            __m128i is_three = _mm_cmplt_epi32(cp, three_octets_max32);
+            __m128i two = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(cp, 6), two_octet_tags32),
+                                       _mm_slli_epi32(_mm_and_si128(cp, low6_32), 8));
+            __m128i three = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(cp, 12), three_octet_tags32),
+                                         _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(cp, 6), low6_32), 8),
+                                                      _mm_slli_epi32(_mm_and_si128(cp, low6_32), 16)));
+            __m128i four = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(cp, 18), four_octet_tags32),
+                                        _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(cp, 12), low6_32), 8),
+                                                     _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(cp, 6), low6_32), 16),
+                                                                  _mm_slli_epi32(_mm_and_si128(cp, low6_32), 24))));
+            __m128i lanes = _mm_or_si128(_mm_and_si128(is_three, three), _mm_andnot_si128(is_three, four));
+            lanes = _mm_or_si128(_mm_and_si128(is_two, two), _mm_andnot_si128(is_two, lanes));
+            lanes = _mm_or_si128(_mm_and_si128(is_ascii, cp), _mm_andnot_si128(is_ascii, lanes));
+
+            // The compares are -1 when true, so 3 + their sum is length - 1
+            __m128i extra = _mm_add_epi32(three32, _mm_add_epi32(_mm_add_epi32(is_ascii, is_two), is_three));
+            unsigned key = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(extra, 31)))) |
+                           static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(extra, 30)))) << 4;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(lanes,
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.pack1234[key]))));
+            in += 4;
+            out += tables.pack1234_length[key];
+        }
+        it = in;
+        result = out;
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    template <typename octet_type, typename unit_type, int size>
+    inline void decode_octets(octet_type*&, octet_type*, unit_type*&, bool, unit_size<size>)
+    {
+    }
+
+#ifdef UTF8_CPP_X86
+    template <typename octet_type, typename unit_type>
+    void decode_octets(octet_type*& start, octet_type* end, unit_type*& result, bool validate)
+    {
+        if (utf8::internal::active_simd_level() < simd_sse42)
+            return;
+        const uint8_t* first = reinterpret_cast<const uint8_t*>(start);
+        const uint8_t* last  = reinterpret_cast<const uint8_t*>(end);
+        const uint8_t* it = first;
+        if (validate) {
+            // Validate and convert in chunks that stay in the cache
+            while (last - it >= 64) {
+                const uint8_t* chunk_end = (last - it > 16384) ? it + 16384 : last;
+                const uint8_t* valid_end = utf8::internal::valid_prefix(it, chunk_end);
+                if (valid_end - it < 16)
+                    break; // an error is close; leave it to the caller
+                utf8::internal::ssse3_decode_utf8(it, valid_end, result);
+            }
+        }
+        else
+            utf8::internal::ssse3_decode_utf8(it, last, result);
+        start += it - first;
+    }
+
+    template <typename octet_type, typename unit_type>
+    inline void decode_octets(octet_type*& start, octet_type* end, unit_type*& result, bool validate, unit_size<2>)
+    {
+        utf8::internal::decode_octets(start, end, result, validate);
+    }
+
+    template <typename octet_type, typename unit_type>
+    inline void decode_octets(octet_type*& start, octet_type* end, unit_type*& result, bool validate, unit_size<4>)
+    {
+        utf8::internal::decode_octets(start, end, result, validate);
+    }
+#endif // #ifdef UTF8_CPP_X86
+
+    // The raw pointer overloads below count the runs they go over in an
+    // instrumented build (see instrument.h), as the callers would have
+    // counted them sequence by sequence.
+
+    /// bulk_decode_utf8 converts the leading part of [start, end) into
+    /// UTF-16 (unit_bytes == 2) or UTF-32 (unit_bytes == 4) when both ranges
+    /// are raw pointers, and advances start and result past it. With
+    /// validate set, it stops short of the first invalid sequence; the
+    /// caller carries on from there and reports the error.
+    template <int unit_bytes, typename octet_iterator, typename unit_iterator>
+    inline void bulk_decode_utf8(octet_iterator&, octet_iterator, unit_iterator&, bool)
+    {
+    }
+
+    template <int unit_bytes, typename octet_type, typename unit_type>
+    inline void bulk_decode_utf8(octet_type*& start, octet_type* end, unit_type*& result, bool validate)
+    {
+        const int size = (sizeof(octet_type) == 1 && sizeof(unit_type) == unit_bytes) ? unit_bytes : 0;
+        octet_type* first = start;
+        utf8::internal::decode_octets(start, end, result, validate, unit_size<size>());
+        utf8::internal::count_run(first, start, (validate ? run_decoded : 0) | (unit_bytes == 2 ? run_surrogate_pairs : 0));
+    }
+
+    /// bulk_utf16to8 encodes the leading part of [start, end) when both
+    /// ranges are raw pointers, up to the first lone surrogate or the last
+    /// few units, and advances start and result past it
+    template <typename u16bit_iterator, typename octet_iterator>
+    inline void bulk_utf16to8(u16bit_iterator&, u16bit_iterator, octet_iterator&)
+    {
+    }
+
+    template <typename u16_type, typename octet_type>
+    inline void bulk_utf16to8(u16_type*& start, u16_type* end, octet_type*& result)
+    {
+#ifdef UTF8_CPP_X86
+        if (sizeof(u16_type) == 2 && sizeof(octet_type) == 1 && utf8::internal::active_simd_level() >= simd_sse42) {
+            octet_type* first = result;
+            utf8::internal::ssse3_utf16to8(start, end, result);
+            utf8::internal::count_run(first, result, run_encoded | run_surrogate_pairs);
+        }
+#else
+        (void)start; (void)end; (void)result;
+#endif
+    }
+
+    /// bulk_utf32to8 encodes the leading part of [start, end) when both
+    /// ranges are raw pointers, up to the first value that append would
+    /// not encode (with validate set, append's checked variant) or the last
+    /// few units, and advances start and result past it
+    template <typename u32bit_iterator, typename octet_iterator>
+    inline void bulk_utf32to8(u32bit_iterator&, u32bit_iterator, octet_iterator&, bool)
+    {
+    }
+
+    template <typename u32_type, typename octet_type>
+    inline void bulk_utf32to8(u32_type*& start, u32_type* end, octet_type*& result, bool validate)
+    {
+#ifdef UTF8_CPP_X86
+        if (sizeof(u32_type) == 4 && sizeof(octet_type) == 1 && utf8::internal::active_simd_level() >= simd_sse42) {
+            octet_type* first = result;
+            utf8::internal::ssse3_utf32to8(start, end, result, validate);
+            utf8::internal::count_run(first, result, run_encoded);
+        }
+#else
+        (void)start; (void)end; (void)result; (void)validate;
+#endif
+    }
+
+    /// skip_ascii returns the end of the ASCII run starting at it.
+    /// Only raw pointers to octets are scanned in bulk; other iterators are
+    /// returned unchanged, and the callers take their usual per-octet path.
+    /// As with copy_ascii, an instrumented build counts the run as decoded
+    /// only when checked is set.
+    template <typename octet_iterator>
+    inline octet_iterator skip_ascii(octet_iterator it, octet_iterator, bool)
+    {
+        return it;
+    }
+
+    template <typename octet_type>
+    inline octet_type* skip_ascii(octet_type* it, octet_type* end, bool checked)
+    {
+        if (sizeof(octet_type) != 1 || it == end || static_cast<uint8_t>(*it) >= 0x80)
+            return it;
+
+        const uint8_t* first = reinterpret_cast<const uint8_t*>(it);
+        const uint8_t* last  = reinterpret_cast<const uint8_t*>(end);
+        const uint8_t* ascii_end = utf8::internal::find_non_ascii(first, last);
+        if (checked)
+            utf8::internal::count_run(first, ascii_end, run_decoded);
+        return it + (ascii_end - first);
+    }
+
+    /// copy_ascii copies the ASCII run starting at start to result, one
+    /// octet to a unit, and advances both past it. Only raw pointers on both
+    /// sides are copied in bulk, a word of eight octets at a time; for other
+    /// iterators it does nothing. The checked functions set checked, for an
+    /// instrumented build to count the run as decoded.
+    template <typename octet_iterator, typename output_iterator>
+    inline void copy_ascii(octet_iterator&, octet_iterator, output_iterator&, bool)
+    {
+    }
+
+    template <typename octet_type, typename unit_type>
+    inline void copy_ascii(octet_type*& start, octet_type* end, unit_type*& result, bool checked)
+    {
+        if (sizeof(octet_type) != 1)
+            return;
+
+        const uint8_t* first = reinterpret_cast<const uint8_t*>(start);
+        const uint8_t* last  = reinterpret_cast<const uint8_t*>(end);
+        const uint8_t* it = first;
+        unit_type* out = result;
+        for (; last - it >= 8; it += 8, out += 8) {
+            if (utf8::internal::load_word(it) & utf8::internal::high_bits())
+                break;
+            for (int i = 0; i < 8; ++i)
+                out[i] = static_cast<unit_type>(it[i]);
+        }
+        for (; it != last && *it < 0x80; ++it)
+            *out++ = static_cast<unit_type>(*it);
+        if (checked)
+            utf8::internal::count_run(first, it, run_decoded);
+        start += it - first;
+        result = out;
+    }
+
+    /// bulk_count counts the octets in [first, last) that start a sequence,
+    /// for raw octet pointers; other iterators give -1.
+    template <typename octet_iterator>
+    inline std::ptrdiff_t bulk_count(octet_iterator, octet_iterator)
+    {
+        return -1;
+    }
+
+    template <typename octet_type>
+    inline std::ptrdiff_t bulk_count(octet_type* first, octet_type* last)
+    {
+        if (sizeof(octet_type) != 1)
+            return -1;
+
+        return utf8::internal::count_code_points(reinterpret_cast<const uint8_t*>(first),
+                                                 reinterpret_cast<const uint8_t*>(last));
+    }
+
+    /// skip_valid returns a sequence boundary such that [it, boundary) is
+    /// valid UTF-8; as with skip_ascii, only raw octet pointers are scanned.
+    template <typename octet_iterator>
+    inline octet_iterator skip_valid(octet_iterator it, octet_iterator)
+    {
+        return it;
+    }
+
+    template <typename octet_type>
+    inline octet_type* skip_valid(octet_type* it, octet_type* end)
+    {
+        if (sizeof(octet_type) != 1)
+            return it;
+
+        const uint8_t* first = reinterpret_cast<const uint8_t*>(it);
+        const uint8_t* last  = reinterpret_cast<const uint8_t*>(end);
+        const uint8_t* valid_end = utf8::internal::valid_prefix(first, last);
+        utf8::internal::count_run(first, valid_end, run_decoded);
+        return it + (valid_end - first);
+    }
+
+    /// bulk_distance counts the code points in a valid leading part of
+    /// [first, last) and advances first past it; as with skip_ascii, only
+    /// raw octet pointers are counted in bulk.
+    template <typename octet_iterator>
+    inline std::ptrdiff_t bulk_distance(octet_iterator&, octet_iterator)
+    {
+        return 0;
+    }
+
+    template <typename octet_type>
+    inline std::ptrdiff_t bulk_distance(octet_type*& first, octet_type* last)
+    {
+        if (sizeof(octet_type) != 1)
+            return 0;
+
+        const uint8_t* start = reinterpret_cast<const uint8_t*>(first);
+        std::ptrdiff_t count = 0;
+        const uint8_t* valid_end = utf8::internal::valid_count<false>(start, reinterpret_cast<const uint8_t*>(last), count);
+        utf8::internal::count_run(start, valid_end, run_decoded);
+        first += valid_end - start;
+        return count;
+    }
+
+    /// bulk_advance moves it forward by most of n code points, but fewer
+    /// than n, and returns how many; the callers step over the rest. Over
+    /// [it, end) it checks the octets, without end it takes them to be valid
+    /// UTF-8 that holds n code points. As with skip_ascii, only raw octet
+    /// pointers are advanced in bulk.
+    template <typename octet_iterator, typename distance_type>
+    inline distance_type bulk_advance(octet_iterator&, octet_iterator, distance_type)
+    {
+        return 0;
+    }
+
+    template <typename octet_iterator, typename distance_type>
+    inline distance_type bulk_advance(octet_iterator&, distance_type)
+    {
+        return 0;
+    }
+
+    template <typename octet_type, typename distance_type>
+    inline distance_type bulk_advance(octet_type*& it, octet_type* end, distance_type n)
+    {
+        if (sizeof(octet_type) != 1 || !(n > 64))
+            return 0;
+
+        const uint8_t* start = reinterpret_cast<const uint8_t*>(it);
+        const uint8_t* position = start;
+        const std::ptrdiff_t skipped = utf8::internal::skip_code_points(position,
+                reinterpret_cast<const uint8_t*>(end), static_cast<std::ptrdiff_t>(n), true);
+        utf8::internal::count_run(start, position, run_decoded);
+        it += position - start;
+        return static_cast<distance_type>(skipped);
+    }
+
+    template <typename octet_type, typename distance_type>
+    inline distance_type bulk_advance(octet_type*& it, distance_type n)
+    {
+        if (sizeof(octet_type) != 1 || !(n > 64))
+            return 0;
+
+        const uint8_t* start = reinterpret_cast<const uint8_t*>(it);
+        const uint8_t* position = start;
+        const std::ptrdiff_t skipped = utf8::internal::skip_code_points(position, 0, static_cast<std::ptrdiff_t>(n), false);
+        it += position - start;
+        return static_cast<distance_type>(skipped);
+    }
+
+    /// bulk_utf8to16_length counts the UTF-16 units of a leading part of
+    /// [first, last), valid UTF-8 when validate is set, and advances first
+    /// past it; as with skip_ascii, only raw octet pointers are counted.
+    template <typename octet_iterator>
+    inline std::ptrdiff_t bulk_utf8to16_length(octet_iterator&, octet_iterator, bool)
+    {
+        return 0;
+    }
+
+    template <typename octet_type>
+    inline std::ptrdiff_t bulk_utf8to16_length(octet_type*& first, octet_type* last, bool validate)
+    {
+        if (sizeof(octet_type) != 1)
+            return 0;
+
+        const uint8_t* start = reinterpret_cast<const uint8_t*>(first);
+        const uint8_t* end = reinterpret_cast<const uint8_t*>(last);
+        if (validate) {
+            std::ptrdiff_t count = 0;
+            const uint8_t* valid_end = utf8::internal::valid_count<true>(start, end, count);
+            utf8::internal::count_run(start, valid_end, run_decoded);
+            first += valid_end - start;
+            return count;
+        }
+        first += end - start;
+        return utf8::internal::count_units<true>(start, end);
+    }
+
+    /// bulk_utf16to8_length and bulk_utf32to8_length count the UTF-8
+    /// octets of a leading part of [start, end), one that the conversion
+    /// would accept when validate is set, and advance start past it. Only
+    /// raw pointers are counted in bulk.
+    template <typename u16bit_iterator>
+    inline std::ptrdiff_t bulk_utf16to8_length(u16bit_iterator&, u16bit_iterator, bool)
+    {
+        return 0;
+    }
+
+    template <typename u16_type>
+    inline std::ptrdiff_t bulk_utf16to8_length(u16_type*& start, u16_type* end, bool validate)
+    {
+#ifdef UTF8_CPP_X86
+        if (sizeof(u16_type) == 2 && utf8::internal::active_simd_level() >= simd_sse2) {
+            const uint16_t* first = reinterpret_cast<const uint16_t*>(start);
+            const uint16_t* it = first;
+            const std::ptrdiff_t length = utf8::internal::sse2_utf16to8_length(it, reinterpret_cast<const uint16_t*>(end), validate);
+            start += it - first;
+            return length;
+        }
+#else
+        (void)start; (void)end; (void)validate;
+#endif
+        return 0;
+    }
+
+    template <typename u32bit_iterator>
+    inline std::ptrdiff_t bulk_utf32to8_length(u32bit_iterator&, u32bit_iterator, bool)
+    {
+        return 0;
+    }
+
+    template <typename u32_type>
+    inline std::ptrdiff_t bulk_utf32to8_length(u32_type*& start, u32_type* end, bool validate)
+    {
+#ifdef UTF8_CPP_X86
+        if (sizeof(u32_type) == 4 && utf8::internal::active_simd_level() >= simd_sse2) {
+            const uint32_t* first = reinterpret_cast<const uint32_t*>(start);
+            const uint32_t* it = first;
+            const std::ptrdiff_t length = utf8::internal::sse2_utf32to8_length(it, reinterpret_cast<const uint32_t*>(end), validate);
+            start += it - first;
+            return length;
+        }
+#else
+        (void)start; (void)end; (void)validate;
+#endif
+        return 0;
+    }
+
+    /// The bounded variants of the bulk conversions take at most room
+    /// units of output, and take what they write off it. They cut the input
+    /// where even its longest encoding still fits, and leave the code point
+    /// that crosses the cut to the caller.
+    template <int unit_bytes, typename octet_iterator, typename unit_iterator>
+    inline void bulk_decode_utf8(octet_iterator&, octet_iterator, unit_iterator&, std::size_t&)
+    {
+    }
+
+    template <int unit_bytes, typename octet_type, typename unit_type>
+    inline void bulk_decode_utf8(octet_type*& start, octet_type* end, unit_type*& result, std::size_t& room)
+    {
+        // No more units than octets
+        octet_type* limit = static_cast<std::size_t>(end - start) > room ? start + room : end;
+        unit_type* first = result;
+        utf8::internal::bulk_decode_utf8<unit_bytes>(start, limit, result, true);
+        room -= result - first;
+    }
+
+    template <typename u16bit_iterator, typename octet_iterator>
+    inline void bulk_utf16to8(u16bit_iterator&, u16bit_iterator, octet_iterator&, std::size_t&)
+    {
+    }
+
+    template <typename u16_type, typename octet_type>
+    inline void bulk_utf16to8(u16_type*& start, u16_type* end, octet_type*& result, std::size_t& room)
+    {
+        // No more than three octets a unit
+        u16_type* limit = static_cast<std::size_t>(end - start) > room / 3 ? start + room / 3 : end;
+        octet_type* first = result;
+        utf8::internal::bulk_utf16to8(start, limit, result);
+        room -= result - first;
+    }
+
+    template <typename u32bit_iterator, typename octet_iterator>
+    inline void bulk_utf32to8(u32bit_iterator&, u32bit_iterator, octet_iterator&, std::size_t&)
+    {
+    }
+
+    template <typename u32_type, typename octet_type>
+    inline void bulk_utf32to8(u32_type*& start, u32_type* end, octet_type*& result, std::size_t& room)
+    {
+        // No more than four octets a code point
+        u32_type* limit = static_cast<std::size_t>(end - start) > room / 4 ? start + room / 4 : end;
+        octet_type* first = result;
+        utf8::internal::bulk_utf32to8(start, limit, result, true);
+        room -= result - first;
+    }
+
+} // namespace internal
+} // namespace utf8
+
+#endif // header guard
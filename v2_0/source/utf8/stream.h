@@ -0,0 +1,262 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_STREAM_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_STREAM_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+#include "checked.h"
+#include <algorithm>
+
+namespace utf8
+{
+    /// What a stream_decoder makes of the octets fed to it
+    enum stream_mode {
+        stream_validate,    // nothing, it only checks them
+        stream_utf16,       // UTF-16 units, as utf8to16 does
+        stream_utf32,       // UTF-32 code points, as utf8to32 does
+        stream_sanitize     // UTF-8 with invalid sequences replaced, as replace_invalid does
+    };
+
+namespace internal
+{
+    // An output iterator that drops what is written to it
+    struct discard_output {
+        discard_output& operator * () { return *this; }
+        discard_output& operator ++ () { return *this; }
+        discard_output& operator ++ (int) { return *this; }
+        template <typename value_type>
+        discard_output& operator = (const value_type&) { return *this; }
+    };
+} // namespace internal
+
+    // Decodes a UTF-8 stream that arrives in chunks. A sequence that a
+    // chunk cuts off is kept, at most three octets of it, and completed
+    // from the next chunk, so that the result is the same as that of one
+    // call on the whole stream.
+    class stream_decoder {
+        stream_mode mode;
+        uint32_t replacement;
+        uint8_t pending_octets[4];
+        unsigned pending_count;
+        bool skipping;      // after an invalid sequence, its trail octets
+        bool all_valid;
+      public:
+        explicit stream_decoder (stream_mode mode = stream_validate, uint32_t replacement = 0xfffd) :
+                 mode(mode), replacement(replacement), pending_count(0), skipping(false), all_valid(true) {}
+
+        /// Decodes the next chunk into out, and returns the end of what it
+        /// wrote. In the utf16 and utf32 modes an invalid sequence throws
+        /// the exception the conversions throw; after that, the decoder
+        /// needs a reset.
+        template <typename octet_iterator, typename output_iterator>
+        output_iterator feed (octet_iterator start, octet_iterator end, output_iterator out)
+        {
+            switch (mode) {
+                case stream_utf16:    return feed_as<stream_utf16>(start, end, out);
+                case stream_utf32:    return feed_as<stream_utf32>(start, end, out);
+                case stream_sanitize: return feed_as<stream_sanitize>(start, end, out);
+                default:              return feed_as<stream_validate>(start, end, out);
+            }
+        }
+
+        /// Feeds the next chunk and drops the output; returns valid()
+        template <typename octet_iterator>
+        bool feed (octet_iterator start, octet_iterator end)
+        {
+            feed(start, end, internal::discard_output());
+            return all_valid;
+        }
+
+        /// Ends the stream. A sequence that it cuts off makes the input
+        /// invalid: in the sanitize mode it is replaced, and in the utf16
+        /// and utf32 modes it throws not_enough_room.
+        template <typename output_iterator>
+        output_iterator finish (output_iterator out)
+        {
+            const bool truncated = pending_count != 0;
+            pending_count = 0;
+            skipping = false;
+            if (truncated) {
+                if (mode == stream_utf16 || mode == stream_utf32)
+                    throw not_enough_room();
+                all_valid = false;
+                if (mode == stream_sanitize)
+                    out = utf8::append(replacement, out);
+            }
+            return out;
+        }
+
+        /// Ends the stream and drops the output; returns valid()
+        bool finish ()
+        {
+            finish(internal::discard_output());
+            return all_valid;
+        }
+
+        /// Whether the input so far was valid UTF-8. In the validate mode,
+        /// the decoder ignores the rest of the stream once it is not.
+        bool valid () const { return all_valid; }
+
+        /// The number of octets kept from a sequence the last chunk cut off
+        unsigned pending () const { return pending_count; }
+
+        /// Starts on a new stream
+        void reset ()
+        {
+            pending_count = 0;
+            skipping = false;
+            all_valid = true;
+        }
+
+      private:
+        template <int as, typename octet_iterator, typename output_iterator>
+        output_iterator feed_as (octet_iterator start, octet_iterator end, output_iterator out)
+        {
+            if (as == stream_validate && !all_valid)
+                return out;
+
+            // Complete the pending sequence an octet at a time
+            while (pending_count != 0 && start != end) {
+                const octet_iterator taken = start;
+                pending_octets[pending_count++] = utf8::internal::mask8(*start++);
+                uint8_t* it = pending_octets;
+                uint32_t cp = 0;
+                internal::utf_error err_code = utf8::internal::validate_next(it, pending_octets + pending_count, cp);
+                if (err_code == internal::NOT_ENOUGH_ROOM)
+                    continue;
+                if (err_code == internal::UTF8_OK)
+                    out = emit<as>(cp, pending_octets, it, out);
+                else {
+                    // The octet that told the sequence is invalid need not
+                    // belong to it; the trail octets before it do
+                    start = taken;
+                    out = fail<as>(err_code, cp, pending_octets[0], out);
+                    skipping = (as == stream_sanitize);
+                }
+                pending_count = 0;
+                // as decode does, the validate mode stops at the first error
+                if (as == stream_validate && !all_valid)
+                    return out;
+            }
+            return decode<as>(start, end, out);
+        }
+
+        template <int as, typename octet_iterator, typename output_iterator>
+        output_iterator decode (octet_iterator it, octet_iterator end, output_iterator out)
+        {
+            if (skipping) {
+                while (it != end && utf8::internal::is_trail(*it))
+                    ++it;
+                if (it == end)
+                    return out;
+                skipping = false;
+            }
+
+            // The valid leading part in bulk, where the iterators allow
+            if (as == stream_validate || as == stream_sanitize) {
+                octet_iterator valid_end = utf8::internal::skip_valid(it, end);
+                if (as == stream_sanitize)
+                    out = std::copy(it, valid_end, out);
+                it = valid_end;
+            }
+            else
+                utf8::internal::bulk_decode_utf8<as == stream_utf16 ? 2 : 4>(it, end, out, true);
+
+            while (it != end) {
+                if (as == stream_validate)
+                    it = utf8::internal::skip_ascii(it, end, true);
+                else {
+                    utf8::internal::copy_ascii(it, end, out, true);
+                    for (octet_iterator ascii_end = utf8::internal::skip_ascii(it, end, true); it != ascii_end; ++it)
+                        *out++ = utf8::internal::mask8(*it);
+                }
+                if (it == end)
+                    break;
+
+                octet_iterator sequence_start = it;
+                uint32_t cp = 0;
+                internal::utf_error err_code = utf8::internal::validate_next(it, end, cp);
+                if (err_code == internal::UTF8_OK)
+                    out = emit<as>(cp, sequence_start, it, out);
+                else if (err_code == internal::NOT_ENOUGH_ROOM) {
+                    // Keep the rest for the next chunk
+                    for (; it != end; ++it)
+                        pending_octets[pending_count++] = utf8::internal::mask8(*it);
+                }
+                else {
+                    out = fail<as>(err_code, cp, utf8::internal::mask8(*it), out);
+                    if (as == stream_validate)
+                        break;
+                    ++it;
+                    if (err_code != internal::INVALID_LEAD) {
+                        // just one replacement mark for the sequence
+                        while (it != end && utf8::internal::is_trail(*it))
+                            ++it;
+                        skipping = (it == end);
+                    }
+                }
+            }
+            return out;
+        }
+
+        template <int as, typename octet_iterator, typename output_iterator>
+        output_iterator emit (uint32_t cp, octet_iterator sequence_start, octet_iterator sequence_end, output_iterator out)
+        {
+            if (as == stream_utf16) {
+                if (cp > 0xffff) { //make a surrogate pair
+                    utf8::internal::count_surrogate_pair();
+                    *out++ = static_cast<uint16_t>((cp >> 10)   + internal::LEAD_OFFSET);
+                    *out++ = static_cast<uint16_t>((cp & 0x3ff) + internal::TRAIL_SURROGATE_MIN);
+                }
+                else
+                    *out++ = static_cast<uint16_t>(cp);
+            }
+            else if (as == stream_utf32)
+                *out++ = cp;
+            else if (as == stream_sanitize)
+                out = std::copy(sequence_start, sequence_end, out);
+            return out;
+        }
+
+        template <int as, typename output_iterator>
+        output_iterator fail (internal::utf_error err_code, uint32_t cp, uint8_t lead, output_iterator out)
+        {
+            if (as == stream_utf16 || as == stream_utf32) {
+                if (err_code == internal::INVALID_CODE_POINT)
+                    throw invalid_code_point(cp);
+                throw invalid_utf8(lead);
+            }
+            all_valid = false;
+            if (as == stream_sanitize)
+                out = utf8::append(replacement, out);
+            return out;
+        }
+    }; // class stream_decoder
+
+} // namespace utf8
+
+#endif // header guard
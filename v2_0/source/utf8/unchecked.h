@@ -37,6 +37,7 @@ namespace utf8
         template <typename octet_iterator>
         octet_iterator append(uint32_t cp, octet_iterator result)
         {
+            utf8::internal::count_encoded(cp);
             if (cp < 0x80)                        // one octet
                 *(result++) = static_cast<uint8_t>(cp);  
             else if (cp < 0x800) {                // two octets
@@ -112,7 +113,7 @@ namespace utf8
         template <typename octet_iterator, typename distance_type>
         void advance (octet_iterator& it, distance_type n)
         {
-            for (distance_type i = 0; i < n; ++i)
+            for (distance_type i = utf8::internal::bulk_advance(it, n); i < n; ++i)
                 utf8::unchecked::next(it);
         }
 
@@ -120,19 +121,74 @@ namespace utf8
         typename std::iterator_traits<octet_iterator>::difference_type
         distance (octet_iterator first, octet_iterator last)
         {
+            // Raw pointers are counted by their lead octets in bulk
+            const std::ptrdiff_t counted = utf8::internal::bulk_count(first, last);
+            if (counted >= 0)
+                return counted;
+
             typename std::iterator_traits<octet_iterator>::difference_type dist;
             for (dist = 0; first < last; ++dist) 
                 utf8::unchecked::next(first);
             return dist;
         }
 
+        template <typename octet_iterator>
+        typename std::iterator_traits<octet_iterator>::difference_type
+        utf8to16_length (octet_iterator start, octet_iterator end)
+        {
+            typename std::iterator_traits<octet_iterator>::difference_type length =
+                utf8::internal::bulk_utf8to16_length(start, end, false);
+            while (start < end)
+                length += utf8::unchecked::next(start) > 0xffff ? 2 : 1;
+            return length;
+        }
+
+        template <typename octet_iterator>
+        inline typename std::iterator_traits<octet_iterator>::difference_type
+        utf8to32_length (octet_iterator start, octet_iterator end)
+        {
+            return utf8::unchecked::distance(start, end);
+        }
+
+        template <typename u16bit_iterator>
+        typename std::iterator_traits<u16bit_iterator>::difference_type
+        utf16to8_length (u16bit_iterator start, u16bit_iterator end)
+        {
+            typename std::iterator_traits<u16bit_iterator>::difference_type length =
+                utf8::internal::bulk_utf16to8_length(start, end, false);
+            for (; start != end; ++start) {
+                uint32_t cp = utf8::internal::mask16(*start);
+                // Each half of a surrogate pair takes two octets
+                length += cp < 0x80 ? 1 : (cp < 0x800 || utf8::internal::is_surrogate(cp) ? 2 : 3);
+            }
+            return length;
+        }
+
+        template <typename u32bit_iterator>
+        typename std::iterator_traits<u32bit_iterator>::difference_type
+        utf32to8_length (u32bit_iterator start, u32bit_iterator end)
+        {
+            typename std::iterator_traits<u32bit_iterator>::difference_type length =
+                utf8::internal::bulk_utf32to8_length(start, end, false);
+            for (; start != end; ++start) {
+                uint32_t cp = *start;
+                length += cp < 0x80 ? 1 : (cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4));
+            }
+            return length;
+        }
+
         template <typename u16bit_iterator, typename octet_iterator>
         octet_iterator utf16to8 (u16bit_iterator start, u16bit_iterator end, octet_iterator result)
         {       
             while (start != end) {
+                utf8::internal::bulk_utf16to8(start, end, result);
+                if (start == end)
+                    break;
+
                 uint32_t cp = utf8::internal::mask16(*start++);
             // Take care of surrogate pairs first
                 if (utf8::internal::is_lead_surrogate(cp)) {
+                    utf8::internal::count_surrogate_pair();
                     uint32_t trail_surrogate = utf8::internal::mask16(*start++);
                     cp = (cp << 10) + trail_surrogate + internal::SURROGATE_OFFSET;
                 }
@@ -144,9 +200,17 @@ namespace utf8
         template <typename u16bit_iterator, typename octet_iterator>
         u16bit_iterator utf8to16 (octet_iterator start, octet_iterator end, u16bit_iterator result)
         {
+            utf8::internal::bulk_decode_utf8<2>(start, end, result, false);
             while (start < end) {
+                utf8::internal::copy_ascii(start, end, result, false);
+                for (octet_iterator ascii_end = utf8::internal::skip_ascii(start, end, false); start != ascii_end; ++start)
+                    *result++ = static_cast<uint16_t>(utf8::internal::mask8(*start));
+                if (!(start < end))
+                    break;
+
                 uint32_t cp = utf8::unchecked::next(start);
                 if (cp > 0xffff) { //make a surrogate pair
+                    utf8::internal::count_surrogate_pair();
                     *result++ = static_cast<uint16_t>((cp >> 10)   + internal::LEAD_OFFSET);
                     *result++ = static_cast<uint16_t>((cp & 0x3ff) + internal::TRAIL_SURROGATE_MIN);
                 }
@@ -159,8 +223,12 @@ namespace utf8
         template <typename octet_iterator, typename u32bit_iterator>
         octet_iterator utf32to8 (u32bit_iterator start, u32bit_iterator end, octet_iterator result)
         {
-            while (start != end)
+            while (start != end) {
+                utf8::internal::bulk_utf32to8(start, end, result, false);
+                if (start == end)
+                    break;
                 result = utf8::unchecked::append(*(start++), result);
+            }
 
             return result;
         }
@@ -168,8 +236,14 @@ namespace utf8
         template <typename octet_iterator, typename u32bit_iterator>
         u32bit_iterator utf8to32 (octet_iterator start, octet_iterator end, u32bit_iterator result)
         {
-            while (start < end)
-                (*result++) = utf8::unchecked::next(start);
+            utf8::internal::bulk_decode_utf8<4>(start, end, result, false);
+            while (start < end) {
+                utf8::internal::copy_ascii(start, end, result, false);
+                for (octet_iterator ascii_end = utf8::internal::skip_ascii(start, end, false); start != ascii_end; ++start)
+                    (*result++) = utf8::internal::mask8(*start);
+                if (start < end)
+                    (*result++) = utf8::unchecked::next(start);
+            }
 
             return result;
         }
@@ -220,6 +294,70 @@ namespace utf8
             }
           }; // class iterator
 
+        // As utf8::cached_iterator, without checks. The end of the range is
+        // only there so that the iterator does not decode past it.
+        template <typename octet_iterator>
+          class cached_iterator {
+            octet_iterator it;
+            octet_iterator next_it;     // the end of the sequence at it
+            octet_iterator range_end;
+            uint32_t cp;
+            void decode ()
+            {
+                next_it = it;
+                cp = (it == range_end) ? 0 : utf8::unchecked::next(next_it);
+            }
+            public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef uint32_t value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef uint32_t* pointer;
+            typedef uint32_t& reference;
+
+            cached_iterator () : cp(0) {}
+            cached_iterator (const octet_iterator& octet_it, const octet_iterator& range_end) :
+                    it(octet_it), range_end(range_end)
+            {
+                decode();
+            }
+            // the default "big three" are OK
+            octet_iterator base () const { return it; }
+            uint32_t operator * () const { return cp; }
+            bool operator == (const cached_iterator& rhs) const
+            {
+                return (it == rhs.it);
+            }
+            bool operator != (const cached_iterator& rhs) const
+            {
+                return !(operator == (rhs));
+            }
+            cached_iterator& operator ++ ()
+            {
+                it = next_it;
+                decode();
+                return *this;
+            }
+            cached_iterator operator ++ (int)
+            {
+                cached_iterator temp = *this;
+                ++(*this);
+                return temp;
+            }
+            cached_iterator& operator -- ()
+            {
+                cp = utf8::unchecked::prior(it);
+                next_it = it;
+                std::advance(next_it, utf8::internal::sequence_length(it));
+                return *this;
+            }
+            cached_iterator operator -- (int)
+            {
+                cached_iterator temp = *this;
+                --(*this);
+                return temp;
+            }
+          }; // class cached_iterator
+
     } // namespace utf8::unchecked
 } // namespace utf8 
 
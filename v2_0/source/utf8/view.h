@@ -0,0 +1,160 @@
+// Copyright 2006 Nemanja Trifunovic
+
+/*
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef UTF8_FOR_CPP_VIEW_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+#define UTF8_FOR_CPP_VIEW_H_2675DCD0_9480_4c0c_B92A_CC14C027B731
+
+#include "checked.h"
+#include "unchecked.h"
+
+namespace utf8
+{
+    // Ranges of code points that are checked once, when they are made, and
+    // then read without checks. utf8::iterator checks every octet each
+    // time it is read or moved, and compares the ends of its range on every
+    // comparison; the UTF-8 view reads with utf8::unchecked::cached_iterator.
+
+    /// UTF-8 text, checked as utf8::next does: invalid text throws
+    /// invalid_utf8, invalid_code_point or not_enough_room
+    template <typename octet_iterator>
+    class validated_view {
+        octet_iterator first, last;
+        std::size_t code_points;
+      public:
+        typedef utf8::unchecked::cached_iterator<octet_iterator> iterator;
+        typedef iterator const_iterator;
+
+        // distance checks the text as it counts
+        validated_view (octet_iterator first, octet_iterator last) :
+                first(first), last(last), code_points(static_cast<std::size_t>(utf8::distance(first, last))) {}
+
+        iterator begin () const { return iterator(first, last); }
+        iterator end () const { return iterator(last, last); }
+        bool empty () const { return first == last; }
+
+        /// The number of code points
+        std::size_t size () const { return code_points; }
+    };
+
+    /// Iterates over the code points of valid UTF-16
+    template <typename u16bit_iterator>
+    class utf16_iterator {
+        u16bit_iterator it;
+      public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef uint32_t value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef uint32_t* pointer;
+        typedef uint32_t& reference;
+
+        utf16_iterator () {}
+        explicit utf16_iterator (const u16bit_iterator& unit_it) : it(unit_it) {}
+        // the default "big three" are OK
+        u16bit_iterator base () const { return it; }
+        uint32_t operator * () const
+        {
+            u16bit_iterator temp = it;
+            uint32_t cp = utf8::internal::mask16(*temp);
+            if (utf8::internal::is_lead_surrogate(cp))
+                cp = (cp << 10) + utf8::internal::mask16(*++temp) + internal::SURROGATE_OFFSET;
+            return cp;
+        }
+        bool operator == (const utf16_iterator& rhs) const
+        {
+            return (it == rhs.it);
+        }
+        bool operator != (const utf16_iterator& rhs) const
+        {
+            return !(operator == (rhs));
+        }
+        utf16_iterator& operator ++ ()
+        {
+            if (utf8::internal::is_lead_surrogate(utf8::internal::mask16(*it++)))
+                ++it;
+            return *this;
+        }
+        utf16_iterator operator ++ (int)
+        {
+            utf16_iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+        utf16_iterator& operator -- ()
+        {
+            if (utf8::internal::is_trail_surrogate(utf8::internal::mask16(*--it)))
+                --it;
+            return *this;
+        }
+        utf16_iterator operator -- (int)
+        {
+            utf16_iterator temp = *this;
+            --(*this);
+            return temp;
+        }
+    }; // class utf16_iterator
+
+    /// UTF-16 text, checked as utf16to8 does: an unpaired surrogate throws
+    /// invalid_utf16
+    template <typename u16bit_iterator>
+    class validated_view16 {
+        u16bit_iterator first, last;
+        std::size_t code_points;
+      public:
+        typedef utf8::utf16_iterator<u16bit_iterator> iterator;
+        typedef iterator const_iterator;
+
+        validated_view16 (u16bit_iterator first, u16bit_iterator last) : first(first), last(last), code_points(0)
+        {
+            utf8::utf16to8_length(first, last);
+            // every unit but the trail surrogates starts a code point
+            for (u16bit_iterator it = first; it != last; ++it)
+                if (!utf8::internal::is_trail_surrogate(utf8::internal::mask16(*it)))
+                    ++code_points;
+        }
+
+        iterator begin () const { return iterator(first); }
+        iterator end () const { return iterator(last); }
+        bool empty () const { return first == last; }
+
+        /// The number of code points
+        std::size_t size () const { return code_points; }
+    };
+
+    template <typename octet_iterator>
+    inline validated_view<octet_iterator> make_validated_view (octet_iterator first, octet_iterator last)
+    {
+        return validated_view<octet_iterator>(first, last);
+    }
+
+    template <typename u16bit_iterator>
+    inline validated_view16<u16bit_iterator> make_validated_view16 (u16bit_iterator first, u16bit_iterator last)
+    {
+        return validated_view16<u16bit_iterator>(first, last);
+    }
+} // namespace utf8
+
+#endif // header guard
@@ -0,0 +1,1084 @@
+// Compares the bulk paths taken for raw pointers with the per-unit paths
+// taken for other iterators, on random and deliberately broken input.
+#include "../../source/utf8.h"
+#ifdef UTF8_CPP_CPP11
+#include "../../source/utf8/parallel.h"
+#endif
+using namespace utf8;
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <list>
+#include <deque>
+#include <iterator>
+#include <stdexcept>
+using namespace std;
+
+inline void check_impl (bool condition, const char* file, int line, unsigned seed)
+{
+    if (!condition)
+        cout << "Check Failed! File: " << file << " Line: " << line << " Seed: " << seed << '\n';
+}
+
+#define check(c) check_impl(c, __FILE__, __LINE__, seed);
+
+// A small deterministic generator, so that failures can be reproduced
+struct random_source {
+    unsigned state;
+    explicit random_source(unsigned seed) : state(seed * 2654435761u + 1) {}
+    unsigned operator () (unsigned n)
+    {
+        state = state * 1103515245u + 12345u;
+        return (state >> 8) % n;
+    }
+};
+
+uint32_t random_code_point(random_source& rnd)
+{
+    switch (rnd(6)) {
+        case 0:
+        case 1:  return 0x20 + rnd(0x5f);
+        case 2:  return 0x80 + rnd(0x780);
+        case 3:  return 0x800 + rnd(0xd000);   // up to the surrogates
+        case 4:  return 0xe000 + rnd(0x2000);
+        default: return 0x10000 + rnd(0x100000);
+    }
+}
+
+string random_utf8(random_source& rnd)
+{
+    string text;
+    // Mostly short and long ASCII runs, so that blocks of every kind are hit
+    unsigned count = rnd(4) == 0 ? rnd(8) : rnd(300);
+    // and now and then one that spans several chunks of the bulk converters
+    if (rnd(500) == 0)
+        count = 20000;
+    bool ascii = rnd(3) == 0;
+    for (unsigned i = 0; i < count; ++i)
+        utf8::append(ascii ? 0x20 + rnd(0x5f) : random_code_point(rnd), back_inserter(text));
+    return text;
+}
+
+void corrupt(string& text, random_source& rnd)
+{
+    static const char* const bad_sequences[] = {
+        "\x80", "\xbf", "\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf", "\xe0\x9f\xbf",
+        "\xed\xa0\x80", "\xed\xbf\xbf", "\xf0\x80\x80\xaf", "\xf0\x8d\xa0\x80",
+        "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xf8\x88\x80\x80\x80", "\xfe", "\xff",
+        "\xc2", "\xe6\x97", "\xf0\x9d\x84", "\xe6\x41", "\xf0\x9d\x41\x9e"
+    };
+    unsigned corruptions = 1 + rnd(3);
+    for (unsigned i = 0; i < corruptions; ++i) {
+        size_t pos = text.empty() ? 0 : rnd(static_cast<unsigned>(text.size()));
+        switch (rnd(3)) {
+            case 0:
+                text.insert(pos, bad_sequences[rnd(sizeof(bad_sequences) / sizeof(bad_sequences[0]))]);
+                break;
+            case 1:
+                if (!text.empty())
+                    text[pos] = static_cast<char>(rnd(256));
+                break;
+            default:
+                text.erase(pos, 1);
+        }
+    }
+}
+
+void compare_validation(const string& text, unsigned seed)
+{
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    list<char> octets(text.begin(), text.end());
+
+    const char* invalid = find_invalid(begin, end);
+    list<char>::iterator expected = find_invalid(octets.begin(), octets.end());
+    check (invalid - begin == std::distance(octets.begin(), expected));
+    check (is_valid(begin, end) == (expected == octets.end()));
+
+    const unsigned char* ubegin = reinterpret_cast<const unsigned char*>(begin);
+    check (find_invalid(ubegin, ubegin + text.size()) - ubegin == invalid - begin);
+}
+
+// Runs a checked conversion and records the exception it throws, if any
+template <typename conversion>
+string outcome(conversion convert);
+
+template <typename octet_iterator>
+struct count_code_points {
+    octet_iterator first, last;
+    ptrdiff_t& count;
+    count_code_points(octet_iterator first, octet_iterator last, ptrdiff_t& count) : first(first), last(last), count(count) {}
+    void operator () () const
+    {
+        count = utf8::distance(first, last);
+    }
+};
+
+void compare_distance(const string& text, unsigned seed)
+{
+    // distance compares iterators with <, so the reference needs random access
+    deque<char> octets(text.begin(), text.end());
+    ptrdiff_t count = -1, expected = -1;
+    string result = outcome(count_code_points<const char*>(text.data(), text.data() + text.size(), count));
+    check (result == outcome(count_code_points<deque<char>::iterator>(octets.begin(), octets.end(), expected)));
+    check (count == expected);
+    if (result == "ok")
+        check (unchecked::distance(text.data(), text.data() + text.size()) == expected);
+}
+
+template <typename octet_iterator>
+struct advance_code_points {
+    octet_iterator& it;
+    octet_iterator last;
+    ptrdiff_t n;
+    advance_code_points(octet_iterator& it, octet_iterator last, ptrdiff_t n) : it(it), last(last), n(n) {}
+    void operator () () const
+    {
+        utf8::advance(it, n, last);
+    }
+};
+
+// Steps of every length, up to past the end
+void compare_advance(const string& text, random_source& rnd, unsigned seed)
+{
+    deque<char> octets(text.begin(), text.end());
+    for (int i = 0; i < 4; ++i) {
+        const ptrdiff_t n = rnd(2) ? rnd(100) : rnd(static_cast<unsigned>(text.size() + 2));
+        const char* it = text.data();
+        deque<char>::iterator expected = octets.begin();
+        string result = outcome(advance_code_points<const char*>(it, text.data() + text.size(), n));
+        check (result == outcome(advance_code_points<deque<char>::iterator>(expected, octets.end(), n)));
+        check (it - text.data() == expected - octets.begin());
+        if (result == "ok" && is_valid(text.begin(), text.end())) {
+            const char* unchecked_it = text.data();
+            unchecked::advance(unchecked_it, n);
+            check (unchecked_it == it);
+        }
+    }
+}
+
+template <typename conversion>
+string outcome(conversion convert)
+{
+    try {
+        convert();
+    }
+    catch (invalid_utf8&) {
+        return "invalid_utf8";
+    }
+    catch (invalid_code_point&) {
+        return "invalid_code_point";
+    }
+    catch (not_enough_room&) {
+        return "not_enough_room";
+    }
+    return "ok";
+}
+
+struct to_utf16 {
+    const string& text;
+    vector<unsigned short>& units;
+    size_t& count;
+    to_utf16(const string& text, vector<unsigned short>& units, size_t& count) : text(text), units(units), count(count) {}
+    void operator () () const
+    {
+        count = utf8to16(text.data(), text.data() + text.size(), &units[0]) - &units[0];
+    }
+};
+
+struct to_utf16_expected {
+    const string& text;
+    vector<unsigned short>& units;
+    to_utf16_expected(const string& text, vector<unsigned short>& units) : text(text), units(units) {}
+    void operator () () const
+    {
+        list<char> octets(text.begin(), text.end());
+        utf8to16(octets.begin(), octets.end(), back_inserter(units));
+    }
+};
+
+template <typename octet_iterator>
+struct measure_utf16 {
+    octet_iterator first, last;
+    ptrdiff_t& length;
+    measure_utf16(octet_iterator first, octet_iterator last, ptrdiff_t& length) : first(first), last(last), length(length) {}
+    void operator () () const
+    {
+        length = utf8to16_length(first, last);
+    }
+};
+
+void compare_utf16(const string& text, unsigned seed)
+{
+    vector<unsigned short> units(text.size() + 1), expected;
+    size_t count = 0;
+    string result = outcome(to_utf16(text, units, count));
+    check (result == outcome(to_utf16_expected(text, expected)));
+    list<char> octets(text.begin(), text.end());
+    ptrdiff_t length = -1, listed_length = -1;
+    check (result == outcome(measure_utf16<const char*>(text.data(), text.data() + text.size(), length)));
+    check (result == outcome(measure_utf16<list<char>::iterator>(octets.begin(), octets.end(), listed_length)));
+    if (result != "ok")
+        return;
+    check (count == expected.size() && equal(expected.begin(), expected.end(), units.begin()));
+    check (length == static_cast<ptrdiff_t>(count) && listed_length == length);
+    check (unchecked::utf8to16_length(text.data(), text.data() + text.size()) == length);
+#ifdef UTF8_CPP_CPP11
+    u16string whole = utf8to16(text);
+    check (whole.size() == count && equal(expected.begin(), expected.end(), whole.begin()));
+#endif
+
+    vector<unsigned short> unchecked_units(text.size() + 1);
+    unsigned short* unchecked_end = unchecked::utf8to16(text.data(), text.data() + text.size(), &unchecked_units[0]);
+    check (unchecked_end - &unchecked_units[0] == static_cast<ptrdiff_t>(count));
+    check (equal(expected.begin(), expected.end(), unchecked_units.begin()));
+}
+
+struct from_utf16 {
+    const vector<unsigned short>& units;
+    string& octets;
+    from_utf16(const vector<unsigned short>& units, string& octets) : units(units), octets(octets) {}
+    void operator () () const
+    {
+        octets.resize(units.size() * 3);
+        char* end = utf16to8(&units[0], &units[0] + units.size(), &octets[0]);
+        octets.resize(end - &octets[0]);
+    }
+};
+
+struct from_utf16_expected {
+    const vector<unsigned short>& units;
+    string& octets;
+    from_utf16_expected(const vector<unsigned short>& units, string& octets) : units(units), octets(octets) {}
+    void operator () () const
+    {
+        list<unsigned short> listed(units.begin(), units.end());
+        utf16to8(listed.begin(), listed.end(), back_inserter(octets));
+    }
+};
+
+template <typename u16bit_iterator>
+struct measure_utf16to8 {
+    u16bit_iterator first, last;
+    ptrdiff_t& length;
+    measure_utf16to8(u16bit_iterator first, u16bit_iterator last, ptrdiff_t& length) : first(first), last(last), length(length) {}
+    void operator () () const
+    {
+        length = utf16to8_length(first, last);
+    }
+};
+
+template <typename conversion>
+string outcome16(conversion convert)
+{
+    try {
+        convert();
+    }
+    catch (invalid_utf16&) {
+        return "invalid_utf16";
+    }
+    return "ok";
+}
+
+void compare_utf16to8(const string& text, random_source& rnd, unsigned seed)
+{
+    if (!is_valid(text.begin(), text.end()))
+        return;
+    vector<unsigned short> units;
+    utf8to16(text.begin(), text.end(), back_inserter(units));
+    units.push_back(0); // so that &units[0] is fine for empty input
+    units.pop_back();
+
+    string octets;
+    check (outcome16(from_utf16(units, octets)) == "ok");
+    check (octets == text);
+    octets.assign(units.size() * 3, '\0');
+    octets.resize(unchecked::utf16to8(&units[0], &units[0] + units.size(), &octets[0]) - &octets[0]);
+    check (octets == text);
+    ptrdiff_t length = -1;
+    check (outcome16(measure_utf16to8<const unsigned short*>(&units[0], &units[0] + units.size(), length)) == "ok");
+    check (length == static_cast<ptrdiff_t>(text.size()));
+    check (unchecked::utf16to8_length(&units[0], &units[0] + units.size()) == length);
+#ifdef UTF8_CPP_CPP11
+    check (utf16to8(u16string(units.begin(), units.end())) == text);
+#endif
+
+    // Lone surrogates, each followed by a valid pair now and then
+    static const unsigned short lone[] = {0xd800, 0xdbff, 0xdc00, 0xdfff};
+    unsigned corruptions = 1 + rnd(2);
+    for (unsigned i = 0; i < corruptions; ++i) {
+        vector<unsigned short>::iterator pos = units.begin() + (units.empty() ? 0 : rnd(static_cast<unsigned>(units.size())));
+        if (pos != units.end() && *pos >= 0xdc00 && *pos <= 0xdfff)
+            ++pos; // keep existing pairs together
+        pos = units.insert(pos, lone[rnd(4)]);
+        if (rnd(2)) {
+            static const unsigned short pair[] = {0xd834, 0xdd1e};
+            units.insert(pos + 1, pair, pair + 2);
+        }
+    }
+    string expected;
+    string result = outcome16(from_utf16(units, octets));
+    check (result == outcome16(from_utf16_expected(units, expected)));
+    list<unsigned short> listed(units.begin(), units.end());
+    ptrdiff_t listed_length = -1;
+    check (result == outcome16(measure_utf16to8<const unsigned short*>(&units[0], &units[0] + units.size(), length)));
+    check (result == outcome16(measure_utf16to8<list<unsigned short>::iterator>(listed.begin(), listed.end(), listed_length)));
+    if (result == "ok") {
+        check (octets == expected);
+        check (length == static_cast<ptrdiff_t>(expected.size()) && listed_length == length);
+    }
+}
+
+struct to_utf32 {
+    const string& text;
+    vector<unsigned>& code_points;
+    size_t& count;
+    to_utf32(const string& text, vector<unsigned>& code_points, size_t& count) : text(text), code_points(code_points), count(count) {}
+    void operator () () const
+    {
+        count = utf8to32(text.data(), text.data() + text.size(), &code_points[0]) - &code_points[0];
+    }
+};
+
+struct to_utf32_expected {
+    const string& text;
+    vector<unsigned>& code_points;
+    to_utf32_expected(const string& text, vector<unsigned>& code_points) : text(text), code_points(code_points) {}
+    void operator () () const
+    {
+        list<char> octets(text.begin(), text.end());
+        utf8to32(octets.begin(), octets.end(), back_inserter(code_points));
+    }
+};
+
+void compare_utf32(const string& text, unsigned seed)
+{
+    vector<unsigned> code_points(text.size() + 1), expected;
+    size_t count = 0;
+    string result = outcome(to_utf32(text, code_points, count));
+    check (result == outcome(to_utf32_expected(text, expected)));
+    if (result != "ok")
+        return;
+    check (count == expected.size() && equal(expected.begin(), expected.end(), code_points.begin()));
+    check (utf8to32_length(text.data(), text.data() + text.size()) == static_cast<ptrdiff_t>(count));
+#ifdef UTF8_CPP_CPP11
+    u32string whole = utf8to32(text);
+    check (whole.size() == count && equal(expected.begin(), expected.end(), whole.begin()));
+#endif
+
+    vector<unsigned> unchecked_code_points(text.size() + 1);
+    unsigned* unchecked_end = unchecked::utf8to32(text.data(), text.data() + text.size(), &unchecked_code_points[0]);
+    check (unchecked_end - &unchecked_code_points[0] == static_cast<ptrdiff_t>(count));
+    check (equal(expected.begin(), expected.end(), unchecked_code_points.begin()));
+}
+
+struct from_utf32 {
+    const vector<unsigned>& code_points;
+    string& octets;
+    from_utf32(const vector<unsigned>& code_points, string& octets) : code_points(code_points), octets(octets) {}
+    void operator () () const
+    {
+        octets.assign(code_points.size() * 4, '\0');
+        char* end = utf32to8(&code_points[0], &code_points[0] + code_points.size(), &octets[0]);
+        octets.resize(end - &octets[0]);
+    }
+};
+
+struct from_utf32_expected {
+    const vector<unsigned>& code_points;
+    string& octets;
+    from_utf32_expected(const vector<unsigned>& code_points, string& octets) : code_points(code_points), octets(octets) {}
+    void operator () () const
+    {
+        list<unsigned> listed(code_points.begin(), code_points.end());
+        utf32to8(listed.begin(), listed.end(), back_inserter(octets));
+    }
+};
+
+template <typename u32bit_iterator>
+struct measure_utf32to8 {
+    u32bit_iterator first, last;
+    ptrdiff_t& length;
+    measure_utf32to8(u32bit_iterator first, u32bit_iterator last, ptrdiff_t& length) : first(first), last(last), length(length) {}
+    void operator () () const
+    {
+        length = utf32to8_length(first, last);
+    }
+};
+
+void compare_utf32to8(const string& text, random_source& rnd, unsigned seed)
+{
+    if (!is_valid(text.begin(), text.end()))
+        return;
+    vector<unsigned> code_points;
+    utf8to32(text.begin(), text.end(), back_inserter(code_points));
+    code_points.push_back(0); // so that &code_points[0] is fine for empty input
+    code_points.pop_back();
+
+    string octets;
+    check (outcome(from_utf32(code_points, octets)) == "ok");
+    check (octets == text);
+    octets.assign(code_points.size() * 4, '\0');
+    octets.resize(unchecked::utf32to8(&code_points[0], &code_points[0] + code_points.size(), &octets[0]) - &octets[0]);
+    check (octets == text);
+    ptrdiff_t length = -1;
+    check (outcome(measure_utf32to8<const unsigned*>(&code_points[0], &code_points[0] + code_points.size(), length)) == "ok");
+    check (length == static_cast<ptrdiff_t>(text.size()));
+    check (unchecked::utf32to8_length(&code_points[0], &code_points[0] + code_points.size()) == length);
+#ifdef UTF8_CPP_CPP11
+    check (utf32to8(u32string(code_points.begin(), code_points.end())) == text);
+#endif
+
+    // Values that the checked conversion rejects; the unchecked one only
+    // passes the surrogates through
+    static const unsigned bad[] = {0xd800, 0xdfff, 0x110000, 0x7fffffff, 0x80000000, 0xffffffff};
+    unsigned corruptions = 1 + rnd(2);
+    bool surrogates_only = true;
+    for (unsigned i = 0; i < corruptions; ++i) {
+        unsigned value = bad[rnd(sizeof(bad) / sizeof(bad[0]))];
+        surrogates_only = surrogates_only && value < 0x110000;
+        code_points.insert(code_points.begin() + rnd(static_cast<unsigned>(code_points.size()) + 1), value);
+    }
+    string expected;
+    string result = outcome(from_utf32(code_points, octets));
+    check (result == "invalid_code_point");
+    check (result == outcome(from_utf32_expected(code_points, expected)));
+    check (result == outcome(measure_utf32to8<const unsigned*>(&code_points[0], &code_points[0] + code_points.size(), length)));
+    list<unsigned> listed(code_points.begin(), code_points.end());
+    check (result == outcome(measure_utf32to8<list<unsigned>::iterator>(listed.begin(), listed.end(), length)));
+    if (surrogates_only) {
+        expected.clear();
+        unchecked::utf32to8(listed.begin(), listed.end(), back_inserter(expected));
+        octets.assign(code_points.size() * 4, '\0');
+        octets.resize(unchecked::utf32to8(&code_points[0], &code_points[0] + code_points.size(), &octets[0]) - &octets[0]);
+        check (octets == expected);
+        check (unchecked::utf32to8_length(&code_points[0], &code_points[0] + code_points.size()) == static_cast<ptrdiff_t>(expected.size()));
+    }
+}
+
+// The bounded conversions, run in slices of random room and resumed each
+// time, on raw pointers and on deque iterators
+struct bounded_utf8to16 {
+    template <typename input, typename output>
+    conversion_result<input, output> operator () (input start, input end, output result, size_t room) const
+    {
+        return utf8to16_bounded(start, end, result, room);
+    }
+};
+
+struct bounded_utf8to32 {
+    template <typename input, typename output>
+    conversion_result<input, output> operator () (input start, input end, output result, size_t room) const
+    {
+        return utf8to32_bounded(start, end, result, room);
+    }
+};
+
+struct bounded_utf16to8 {
+    template <typename input, typename output>
+    conversion_result<input, output> operator () (input start, input end, output result, size_t room) const
+    {
+        return utf16to8_bounded(start, end, result, room);
+    }
+};
+
+struct bounded_utf32to8 {
+    template <typename input, typename output>
+    conversion_result<input, output> operator () (input start, input end, output result, size_t room) const
+    {
+        return utf32to8_bounded(start, end, result, room);
+    }
+};
+
+template <typename convert, typename input_unit, typename output_unit>
+conversion_status convert_in_slices(convert conv, const vector<input_unit>& input, vector<output_unit>& output,
+                                    size_t& consumed, random_source& rnd, unsigned seed)
+{
+    input_unit dummy[1] = {0};
+    const input_unit* in = input.empty() ? dummy : &input[0];
+    const input_unit* const end = in + input.size();
+    output.assign(input.size() * 4 + 4, 0);
+    output_unit* out = &output[0];
+    deque<input_unit> listed(input.begin(), input.end());
+    typename deque<input_unit>::iterator listed_in = listed.begin();
+    deque<output_unit> listed_output(output.size());
+    typename deque<output_unit>::iterator listed_out = listed_output.begin();
+    consumed = 0;
+    conversion_status status = conversion_output_full;
+    while (status == conversion_output_full) {
+        size_t room = rnd(4) == 0 ? rnd(5) : rnd(3000);
+        conversion_result<const input_unit*, output_unit*> r = conv(in, end, out, room);
+        conversion_result<typename deque<input_unit>::iterator, typename deque<output_unit>::iterator> l =
+            conv(listed_in, listed.end(), listed_out, room);
+        check (r.status == l.status && r.consumed == l.consumed && r.written == l.written);
+        check (r.in - in == static_cast<ptrdiff_t>(r.consumed) && r.out - out == static_cast<ptrdiff_t>(r.written));
+        check (l.in - listed_in == static_cast<ptrdiff_t>(l.consumed) && l.out - listed_out == static_cast<ptrdiff_t>(l.written));
+        check (r.written <= room && equal(out, r.out, listed_out));
+        if (r.status == conversion_output_full) {
+            // the next code point really does not fit
+            output_unit next[4];
+            conversion_result<const input_unit*, output_unit*> one = conv(r.in, end, next, 4);
+            check (one.written > room - r.written);
+        }
+        else {
+            check (r.status != conversion_ok || r.in == end);
+        }
+        in = r.in;
+        out = r.out;
+        listed_in = l.in;
+        listed_out = l.out;
+        consumed += r.consumed;
+        status = r.status;
+    }
+    output.resize(out - &output[0]);
+    return status;
+}
+
+// The exception each status stands for
+string thrown_for(conversion_status status)
+{
+    switch (status) {
+        case conversion_ok:                 return "ok";
+        case conversion_incomplete:         return "not_enough_room";
+        case conversion_invalid_utf8:       return "invalid_utf8";
+        case conversion_invalid_utf16:      return "invalid_utf16";
+        case conversion_invalid_code_point: return "invalid_code_point";
+        default:                            return "output_full";
+    }
+}
+
+void compare_bounded(const string& text, random_source& rnd, unsigned seed)
+{
+    vector<char> octets(text.begin(), text.end());
+    vector<unsigned short> units, expected_units;
+    size_t consumed = 0;
+    conversion_status status = convert_in_slices(bounded_utf8to16(), octets, units, consumed, rnd, seed);
+    check (thrown_for(status) == outcome(to_utf16_expected(text, expected_units)));
+    // up to where it stopped, the same as the unbounded conversion
+    expected_units.clear();
+    utf8to16(octets.begin(), octets.begin() + consumed, back_inserter(expected_units));
+    check (units == expected_units);
+
+    vector<unsigned> code_points, expected_code_points;
+    check (convert_in_slices(bounded_utf8to32(), octets, code_points, consumed, rnd, seed) == status);
+    utf8to32(octets.begin(), octets.begin() + consumed, back_inserter(expected_code_points));
+    check (code_points == expected_code_points);
+    if (status != conversion_ok)
+        return;
+
+    // and back, with a lone surrogate or an invalid code point now and then
+    vector<char> back;
+    if (!units.empty() && rnd(3) == 0)
+        units.insert(units.begin() + rnd(static_cast<unsigned>(units.size())), static_cast<unsigned short>(0xd800 + rnd(0x800)));
+    status = convert_in_slices(bounded_utf16to8(), units, back, consumed, rnd, seed);
+    string expected;
+    string result = outcome16(from_utf16_expected(units, expected));
+    if (status == conversion_incomplete) {
+        check (consumed + 1 == units.size() && result == "invalid_utf16");
+    }
+    else {
+        check (thrown_for(status) == result);
+    }
+    check (equal(back.begin(), back.end(), text.begin()) || status != conversion_ok);
+    expected.clear();
+    utf16to8(units.begin(), units.begin() + consumed, back_inserter(expected));
+    check (string(back.begin(), back.end()) == expected);
+
+    if (!code_points.empty() && rnd(3) == 0)
+        code_points.insert(code_points.begin() + rnd(static_cast<unsigned>(code_points.size())), rnd(2) ? 0xdc00u : 0x110000u);
+    status = convert_in_slices(bounded_utf32to8(), code_points, back, consumed, rnd, seed);
+    expected.clear();
+    check (thrown_for(status) == outcome(from_utf32_expected(code_points, expected)));
+    expected.clear();
+    utf32to8(code_points.begin(), code_points.begin() + consumed, back_inserter(expected));
+    check (string(back.begin(), back.end()) == expected);
+}
+
+// The stream decoder, fed random chunks through raw pointers and through
+// list iterators, against the conversions on the whole text
+struct stream_result {
+    string outcome;
+    bool valid;
+    vector<unsigned> units;
+};
+
+template <typename unit>
+struct feed_chunks {
+    const vector<string>& chunks;
+    stream_mode mode;
+    bool pointers;
+    stream_result& result;
+    feed_chunks(const vector<string>& chunks, stream_mode mode, bool pointers, stream_result& result) :
+        chunks(chunks), mode(mode), pointers(pointers), result(result) {}
+    void operator () () const
+    {
+        stream_decoder decoder(mode);
+        vector<unit> out;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            const string& chunk = chunks[i];
+            if (pointers) {
+                // room for every octet to come out as a replacement mark
+                vector<unit> buffer(chunk.size() * 3 + 4);
+                unit* end = decoder.feed(chunk.data(), chunk.data() + chunk.size(), &buffer[0]);
+                out.insert(out.end(), &buffer[0], end);
+            }
+            else {
+                list<char> octets(chunk.begin(), chunk.end());
+                decoder.feed(octets.begin(), octets.end(), back_inserter(out));
+            }
+        }
+        decoder.finish(back_inserter(out));
+        result.units.assign(out.begin(), out.end());
+        result.valid = decoder.valid();
+    }
+};
+
+template <typename unit>
+stream_result decode_in_chunks(const vector<string>& chunks, stream_mode mode, bool pointers)
+{
+    stream_result result;
+    result.valid = false;
+    result.outcome = outcome(feed_chunks<unit>(chunks, mode, pointers, result));
+    return result;
+}
+
+void compare_stream(const string& text, random_source& rnd, unsigned seed)
+{
+    vector<string> chunks;
+    for (size_t at = 0; at < text.size(); ) {
+        size_t size = rnd(4) == 0 ? rnd(5) : rnd(2000);
+        chunks.push_back(text.substr(at, size));
+        at += size;
+    }
+
+    // list iterators are slow; they take their turn now and then
+    for (int pointers = rnd(4) == 0 ? 0 : 1; pointers < 2; ++pointers) {
+        stream_decoder validator;
+        for (size_t i = 0; i < chunks.size(); ++i)
+            validator.feed(chunks[i].begin(), chunks[i].end());
+        check (validator.finish() == is_valid(text.begin(), text.end()));
+
+        // A sequence cut off at the end is replaced as one that ends early
+        string expected;
+        string terminated = text + '!';
+        replace_invalid(terminated.begin(), terminated.end(), back_inserter(expected));
+        expected.erase(expected.size() - 1);
+        stream_result sanitized = decode_in_chunks<char>(chunks, stream_sanitize, pointers != 0);
+        check (sanitized.outcome == "ok" && sanitized.valid == (expected == text));
+        check (string(sanitized.units.begin(), sanitized.units.end()) == expected);
+
+        vector<unsigned short> expected_units;
+        stream_result units = decode_in_chunks<unsigned short>(chunks, stream_utf16, pointers != 0);
+        check (units.outcome == outcome(to_utf16_expected(text, expected_units)));
+        if (units.outcome == "ok")
+            check (equal(expected_units.begin(), expected_units.end(), units.units.begin()) && units.units.size() == expected_units.size());
+
+        vector<unsigned> expected_code_points;
+        stream_result code_points = decode_in_chunks<unsigned>(chunks, stream_utf32, pointers != 0);
+        check (code_points.outcome == units.outcome);
+        if (code_points.outcome == "ok") {
+            utf8to32(text.begin(), text.end(), back_inserter(expected_code_points));
+            check (code_points.units == expected_code_points);
+        }
+    }
+}
+
+// The positions of every code point of a valid text, and of its end
+vector<offset_index::position> positions(const string& text)
+{
+    vector<offset_index::position> result;
+    offset_index::position at;
+    for (string::const_iterator it = text.begin(); ; ) {
+        result.push_back(at);
+        if (it == text.end())
+            break;
+        const uint32_t cp = next(it, text.end());
+        at.octets = static_cast<size_t>(it - text.begin());
+        at.code_points += 1;
+        at.units += cp > 0xffff ? 2 : 1;
+    }
+    return result;
+}
+
+bool same_position(const offset_index::position& a, const offset_index::position& b)
+{
+    return a.octets == b.octets && a.code_points == b.code_points && a.units == b.units;
+}
+
+// Lookups at random places, and at the ends, against a walk of the text
+void check_lookups(const string& text, const offset_index& index, random_source& rnd, unsigned seed)
+{
+    const vector<offset_index::position> expected = positions(text);
+    const offset_index::position& end = expected.back();
+    check (same_position(index.size(), end));
+    for (int i = 0; i < 8; ++i) {
+        const size_t code_point = i == 0 ? end.code_points : rnd(static_cast<unsigned>(end.code_points + 1));
+        check (same_position(index.locate_code_point(text.data(), code_point), expected[code_point]));
+
+        // A unit or octet inside a code point gives the start of it
+        const size_t unit = i == 0 ? end.units : rnd(static_cast<unsigned>(end.units + 1));
+        const offset_index::position& by_unit = index.locate_unit(text.begin(), unit);
+        check (by_unit.units <= unit && same_position(by_unit, expected[by_unit.code_points]));
+        check (unit == end.units || expected[by_unit.code_points + 1].units > unit);
+
+        const size_t octet = i == 0 ? end.octets : rnd(static_cast<unsigned>(end.octets + 1));
+        const offset_index::position& by_octet = index.locate_octet(text.data(), octet);
+        check (by_octet.octets <= octet && same_position(by_octet, expected[by_octet.code_points]));
+        check (octet == end.octets || expected[by_octet.code_points + 1].octets > octet);
+    }
+    try {
+        index.locate_code_point(text.data(), end.code_points + 1);
+        check (false);
+    }
+    catch (const not_enough_room&) {}
+}
+
+// An index built on the text, then kept up to date through a few edits
+void compare_index(const string& text, random_source& rnd, unsigned seed)
+{
+    string edited = text;
+    offset_index index(1 + rnd(100));
+    if (rnd(2))
+        index.build(edited.data(), edited.data() + edited.size());
+    else
+        index.build(edited.begin(), edited.end());
+    check_lookups(edited, index, rnd, seed);
+
+    for (int edits = rnd(4); edits > 0; --edits) {
+        // Replace a run of code points with new ones
+        const vector<offset_index::position> at = positions(edited);
+        const size_t first = rnd(static_cast<unsigned>(at.size()));
+        const size_t last = first + rnd(static_cast<unsigned>(min<size_t>(at.size() - first, rnd(2) ? 4 : 500)));
+        const size_t offset = at[first].octets;
+        const size_t removed = at[last].octets - offset;
+        string inserted = rnd(4) == 0 ? string() : random_utf8(rnd);
+        if (inserted.size() > 600)
+            inserted.resize(0);
+        edited.replace(offset, removed, inserted);
+        index.update(edited.data(), offset, removed, inserted.size());
+        check_lookups(edited, index, rnd, seed);
+    }
+
+    // An edit that leaves the text invalid throws
+    if (!edited.empty()) {
+        edited.insert(0, 1, '\x80');
+        try {
+            index.update(edited.begin(), 0, 0, 1);
+            check (false);
+        }
+        catch (const invalid_utf8&) {}
+    }
+}
+
+template <typename octet_iterator>
+struct decode_blocks {
+    octet_iterator first, last;
+    size_t block_size;
+    vector<uint32_t>& code_points;
+    vector<size_t>& offsets;
+    decode_blocks(octet_iterator first, octet_iterator last, size_t block_size, vector<uint32_t>& code_points, vector<size_t>& offsets) :
+        first(first), last(last), block_size(block_size), code_points(code_points), offsets(offsets) {}
+    void operator () () const
+    {
+        block_decoder<octet_iterator> blocks(first, last, block_size, true);
+        while (blocks.next()) {
+            code_points.insert(code_points.end(), blocks.begin(), blocks.end());
+            offsets.insert(offsets.end(), blocks.offsets(), blocks.offsets() + blocks.size());
+        }
+    }
+};
+
+// Blocks of random sizes against utf8to32, and their offsets against a
+// walk of the text
+void compare_blocks(const string& text, random_source& rnd, unsigned seed)
+{
+    const size_t block_size = rnd(2) ? 1 + rnd(8) : 1 + rnd(300);
+    vector<uint32_t> code_points, expected;
+    vector<size_t> offsets, list_offsets;
+    const string result = outcome(decode_blocks<const char*>(text.data(), text.data() + text.size(), block_size, code_points, offsets));
+
+    list<char> octets(text.begin(), text.end());
+    check (result == outcome(decode_blocks<list<char>::iterator>(octets.begin(), octets.end(), block_size, expected, list_offsets)));
+    check (code_points == expected && offsets == list_offsets);
+    if (result == "ok") {
+        expected.clear();
+        utf8to32(text.begin(), text.end(), back_inserter(expected));
+        check (code_points == expected);
+    }
+    check (offsets.size() == code_points.size());
+    const char* it = text.data();
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        check (offsets[i] == static_cast<size_t>(it - text.data()));
+        check (next(it, text.data() + text.size()) == code_points[i]);
+    }
+
+    // The same into a buffer of the caller's, without offsets
+    vector<uint32_t> buffer(block_size);
+    block_decoder<const char*> blocks(text.data(), text.data() + text.size(), &buffer[0], buffer.size());
+    size_t decoded = 0;
+    try {
+        while (blocks.next()) {
+            check (blocks.begin() == &buffer[0] && blocks.size() > 0 && blocks.size() <= block_size && !blocks.offsets());
+            check (equal(blocks.begin(), blocks.end(), code_points.begin() + decoded));
+            decoded += blocks.size();
+        }
+    }
+    catch (const utf8::exception&) {}
+    check (decoded == code_points.size());
+
+    // The same through the block iterators, with offsets
+    block_decoder<list<char>::iterator> list_blocks(octets.begin(), octets.end(), block_size, true);
+    vector<uint32_t> walked;
+    vector<size_t> walked_offsets;
+    try {
+        block_decoder<list<char>::iterator>::block_range range = list_blocks.blocks();
+        for (block_decoder<list<char>::iterator>::block_iterator block = range.begin(); block != range.end(); ++block) {
+            check (block->size > 0 && block->size <= block_size && block->offsets);
+            walked.insert(walked.end(), block->begin(), block->end());
+            walked_offsets.insert(walked_offsets.end(), block->offsets, block->offsets + block->size);
+        }
+    }
+    catch (const utf8::exception&) {}
+    check (walked == code_points && walked_offsets == offsets);
+#ifdef UTF8_CPP_CPP11
+    block_decoder<const char*> range_blocks(text.data(), text.data() + text.size(), block_size);
+    walked.clear();
+    try {
+        for (const auto& block : range_blocks.blocks())
+            walked.insert(walked.end(), block.begin(), block.end());
+    }
+    catch (const utf8::exception&) {}
+    check (walked == code_points);
+#endif // UTF8_CPP_CPP11
+
+    // A buffer of no code points is refused
+    bool refused = false;
+    try {
+        block_decoder<const char*> empty(text.data(), text.data() + text.size(), &buffer[0], 0);
+    }
+    catch (const std::invalid_argument&) {
+        refused = true;
+    }
+    check (refused);
+}
+
+// A step of utf8::iterator, and a read where it lands; it throws for
+// invalid octets when it reads them
+struct step_iterator {
+    utf8::iterator<const char*>& it;
+    bool forward;
+    const char* last;
+    step_iterator(utf8::iterator<const char*>& it, bool forward, const char* last) : it(it), forward(forward), last(last) {}
+    void operator () () const
+    {
+        if (forward)
+            ++it;
+        else
+            --it;
+        if (it.base() != last)
+            *it;
+    }
+};
+
+struct read_iterator {
+    const utf8::iterator<const char*>& it;
+    explicit read_iterator(const utf8::iterator<const char*>& it) : it(it) {}
+    void operator () () const
+    {
+        *it;
+    }
+};
+
+// cached_iterator throws for them when it reaches them
+struct step_cached {
+    cached_iterator<const char*>& it;
+    bool forward;
+    step_cached(cached_iterator<const char*>& it, bool forward) : it(it), forward(forward) {}
+    void operator () () const
+    {
+        if (forward)
+            ++it;
+        else
+            --it;
+    }
+};
+
+struct start_cached {
+    cached_iterator<const char*>& it;
+    const char* start;
+    const char* first;
+    const char* last;
+    start_cached(cached_iterator<const char*>& it, const char* start, const char* first, const char* last) :
+        it(it), start(start), first(first), last(last) {}
+    void operator () () const
+    {
+        it = cached_iterator<const char*>(start, first, last);
+    }
+};
+
+// Random walks of ++ and -- with the cached iterators against the plain
+// ones, which decode afresh at every step. The walks start at a random
+// lead octet, so that -- meets stray trail octets too.
+void compare_iterators(const string& text, random_source& rnd, unsigned seed)
+{
+    const char* first = text.data();
+    const char* last = first + text.size();
+    const char* start = first + rnd(static_cast<unsigned>(text.size() + 1));
+    while (start != first && start != last && utf8::internal::is_trail(*start))
+        --start;
+    utf8::iterator<const char*> it(start, first, last);
+    cached_iterator<const char*> cached;
+    string result = outcome(start_cached(cached, start, first, last));
+    check (result == (start == last ? "ok" : outcome(read_iterator(it))));
+    if (result != "ok")
+        return;
+
+    for (int steps = 0; steps < 200; ++steps) {
+        bool forward = rnd(3) != 0;
+        if (rnd(8) != 0 && (it.base() == first || it.base() == last))
+            forward = it.base() == first;
+        result = outcome(step_cached(cached, forward));
+        check (result == outcome(step_iterator(it, forward, last)));
+        if (result != "ok")
+            return;
+        check (cached.base() == it.base());
+        if (cached.base() != it.base())
+            return;
+        if (it.base() != last)
+            check (*cached == *it);
+    }
+
+    if (!is_valid(first, last))
+        return;
+    unchecked::iterator<const char*> unchecked_it(first);
+    unchecked::cached_iterator<const char*> unchecked_cached(first, last);
+    for (int steps = 0; steps < 200; ++steps) {
+        if (unchecked_it.base() != last && (unchecked_it.base() == first || rnd(3) != 0)) {
+            ++unchecked_it;
+            ++unchecked_cached;
+        }
+        else if (unchecked_it.base() != first) {
+            --unchecked_it;
+            --unchecked_cached;
+        }
+        check (unchecked_cached.base() == unchecked_it.base());
+        if (unchecked_it.base() != last)
+            check (*unchecked_cached == *unchecked_it);
+    }
+}
+
+#ifdef UTF8_CPP_CPP11
+// What a conversion threw, with the unit or code point it blames
+template <typename conversion>
+string thrown(conversion convert)
+{
+    try {
+        convert();
+    }
+    catch (const invalid_utf8& e) {
+        return "invalid_utf8 " + to_string(e.utf8_octet());
+    }
+    catch (const invalid_utf16& e) {
+        return "invalid_utf16 " + to_string(e.utf16_word());
+    }
+    catch (const invalid_code_point& e) {
+        return "invalid_code_point " + to_string(e.code_point());
+    }
+    catch (const not_enough_room&) {
+        return "not_enough_room";
+    }
+    return "ok";
+}
+
+// The parallel versions, with a few threads on small ranges so that the
+// segments end in every kind of place, against the plain functions
+void compare_parallel(const string& text, random_source& rnd, unsigned seed)
+{
+    const unsigned threads = 1 + rnd(8);
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    check (parallel::find_invalid(begin, end, threads) == find_invalid(begin, end));
+    check (parallel::is_valid(begin, end, threads) == is_valid(begin, end));
+
+    vector<unsigned short> units(text.size() + 1), expected_units(text.size() + 1);
+    unsigned short* units_end = 0;
+    unsigned short* expected_units_end = 0;
+    string result = thrown([&] { units_end = parallel::utf8to16(begin, end, &units[0], threads); });
+    check (result == thrown([&] { expected_units_end = utf8to16(begin, end, &expected_units[0]); }));
+    if (result != "ok")
+        return;
+    check (units_end - &units[0] == expected_units_end - &expected_units[0] && equal(&units[0], units_end, &expected_units[0]));
+    units.resize(units_end - &units[0]);
+
+    vector<unsigned> code_points(text.size() + 1);
+    unsigned* code_points_end = parallel::utf8to32(begin, end, &code_points[0], threads);
+    code_points.resize(code_points_end - &code_points[0]);
+    vector<unsigned> expected_code_points;
+    utf8to32(begin, end, back_inserter(expected_code_points));
+    check (code_points == expected_code_points);
+
+    // and back, with a lone surrogate or an invalid code point now and then
+    if (rnd(2))
+        units.insert(units.begin() + rnd(static_cast<unsigned>(units.size() + 1)), static_cast<unsigned short>(0xd800 + rnd(0x800)));
+    string octets(units.size() * 3 + 1, 0), expected(units.size() * 3 + 1, 0);
+    char* octets_end = 0;
+    char* expected_end = 0;
+    result = thrown([&] { octets_end = parallel::utf16to8(units.data(), units.data() + units.size(), &octets[0], threads); });
+    check (result == thrown([&] { expected_end = utf16to8(units.data(), units.data() + units.size(), &expected[0]); }));
+    if (result == "ok")
+        check (string(&octets[0], octets_end) == string(&expected[0], expected_end));
+
+    if (rnd(2))
+        code_points.insert(code_points.begin() + rnd(static_cast<unsigned>(code_points.size() + 1)), rnd(2) ? 0xdc00u : 0x110000u);
+    octets.assign(code_points.size() * 4 + 1, 0);
+    expected.assign(code_points.size() * 4 + 1, 0);
+    result = thrown([&] { octets_end = parallel::utf32to8(code_points.data(), code_points.data() + code_points.size(), &octets[0], threads); });
+    check (result == thrown([&] { expected_end = utf32to8(code_points.data(), code_points.data() + code_points.size(), &expected[0]); }));
+    if (result == "ok")
+        check (string(&octets[0], octets_end) == string(&expected[0], expected_end));
+}
+#endif
+
+int main()
+{
+    // Every level the processor supports, from the most capable one down
+    for (int level = supported_simd_level(); level >= simd_scalar; --level) {
+        unsigned seed = 0;
+        check (set_simd_level(static_cast<simd_level>(level)) == level);
+        for (; seed < 20000; ++seed) {
+            random_source rnd(seed);
+            string text = random_utf8(rnd);
+            compare_validation(text, seed);
+            compare_distance(text, seed);
+            compare_advance(text, rnd, seed);
+            compare_utf16(text, seed);
+            compare_utf32(text, seed);
+            compare_utf16to8(text, rnd, seed);
+            compare_utf32to8(text, rnd, seed);
+            compare_bounded(text, rnd, seed);
+            compare_stream(text, rnd, seed);
+            compare_index(text, rnd, seed);
+            compare_blocks(text, rnd, seed);
+            compare_iterators(text, rnd, seed);
+#ifdef UTF8_CPP_CPP11
+            if (seed % 16 == 0)
+                compare_parallel(text, rnd, seed);
+#endif
+            corrupt(text, rnd);
+            compare_validation(text, seed);
+            compare_distance(text, seed);
+            compare_advance(text, rnd, seed);
+            compare_utf16(text, seed);
+            compare_utf32(text, seed);
+            compare_bounded(text, rnd, seed);
+            compare_stream(text, rnd, seed);
+            compare_blocks(text, rnd, seed);
+            compare_iterators(text, rnd, seed);
+#ifdef UTF8_CPP_CPP11
+            if (seed % 16 == 0)
+                compare_parallel(text, rnd, seed);
+#endif
+        }
+    }
+}
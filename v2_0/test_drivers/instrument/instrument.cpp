@@ -0,0 +1,354 @@
+// Checks the counters of an instrumented build (UTF8_CPP_INSTRUMENT) on
+// input whose sequences and errors are known in advance.
+#include "../../source/utf8.h"
+using namespace utf8;
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <iterator>
+#include <thread>
+using namespace std;
+
+inline void check_impl (bool condition, const char* file, int line)
+{
+    if (!condition)
+        cout << "Check Failed! File: " << file << " Line: " << line << '\n';
+}
+
+#define check(c) check_impl(c, __FILE__, __LINE__);
+
+// One to four octets: "a", U+00E9, U+6C34, U+1D11E
+const char sample[] = "a\xc3\xa9\xe6\xb0\xb4\xf0\x9d\x84\x9e";
+
+void test_decoding()
+{
+    statistics before = thread_statistics();
+    vector<uint16_t> utf16;
+    utf8to16(sample, sample + sizeof(sample) - 1, back_inserter(utf16));
+    statistics counted = thread_statistics() - before;
+
+    check (counted[statistics::octets_decoded] == 10);
+    check (counted[statistics::decoded_length_1] == 1);
+    check (counted[statistics::decoded_length_2] == 1);
+    check (counted[statistics::decoded_length_3] == 1);
+    check (counted[statistics::decoded_length_4] == 1);
+    check (counted[statistics::surrogate_pairs] == 1);
+    check (counted[statistics::octets_encoded] == 0);
+
+    // Raw pointers are counted too, after the bulk kernels
+    before = thread_statistics();
+    check (is_valid(sample, sample + sizeof(sample) - 1));
+    counted = thread_statistics() - before;
+    check (counted[statistics::octets_decoded] == 10);
+}
+
+void test_encoding()
+{
+    statistics before = thread_statistics();
+    string utf8;
+    const uint32_t code_points[] = {0x61, 0xe9, 0x6c34, 0x1d11e};
+    for (int i = 0; i < 4; ++i)
+        append(code_points[i], back_inserter(utf8));
+    const uint16_t utf16[] = {0x61, 0xd834, 0xdd1e};
+    utf16to8(utf16, utf16 + 3, back_inserter(utf8));
+    statistics counted = thread_statistics() - before;
+
+    check (counted[statistics::octets_encoded] == 15);
+    check (counted[statistics::encoded_length_1] == 2);
+    check (counted[statistics::encoded_length_2] == 1);
+    check (counted[statistics::encoded_length_3] == 1);
+    check (counted[statistics::encoded_length_4] == 2);
+    check (counted[statistics::surrogate_pairs] == 1);
+}
+
+void test_errors()
+{
+    statistics before = thread_statistics();
+    // An invalid lead, an incomplete sequence, an overlong sequence and a
+    // surrogate
+    const string broken = "a\xff" "b\xe6\x41" "c\xc0\xaf" "d\xed\xa0\x80" "e";
+    string replaced;
+    replace_invalid(broken.begin(), broken.end(), back_inserter(replaced));
+    // and a sequence cut off by the end
+    const string cut = "\xf0\x9d\x84";
+    check (find_invalid(cut.begin(), cut.end()) == cut.begin());
+    statistics counted = thread_statistics() - before;
+
+    check (counted[statistics::invalid_lead_errors] == 1);
+    check (counted[statistics::incomplete_sequence_errors] == 1);
+    check (counted[statistics::overlong_sequence_errors] == 1);
+    check (counted[statistics::invalid_code_point_errors] == 1);
+    check (counted[statistics::not_enough_room_errors] == 1);
+    check (counted[statistics::replacements] == 4);
+    check (counted[statistics::decoded_length_1] == 6);
+
+    before = thread_statistics();
+    try {
+        append(0xd800, back_inserter(replaced));
+        check (false);
+    }
+    catch (const invalid_code_point&) {}
+    const uint16_t unpaired[] = {0x61, 0xdc00};
+    try {
+        utf16to8(unpaired, unpaired + 2, back_inserter(replaced));
+        check (false);
+    }
+    catch (const invalid_utf16&) {}
+    // The bounded conversions count the errors they stop at
+    const uint32_t surrogate[] = {0x61, 0xdc00};
+    char octets[8];
+    check (utf32to8_bounded(surrogate, surrogate + 2, octets, sizeof(octets)).status == conversion_invalid_code_point);
+    counted = thread_statistics() - before;
+    check (counted[statistics::invalid_code_point_errors] == 2);
+    check (counted[statistics::invalid_utf16_errors] == 1);
+    check (counted[statistics::encoded_length_1] == 2);
+
+    // The validating stream decoder reads no further than its first error,
+    // even one in a sequence that the chunk before cut off
+    before = thread_statistics();
+    stream_decoder validator;
+    const string first_chunk = "a\xe6";
+    const string second_chunk = "\x41" "b\xff" "c";
+    check (validator.feed(first_chunk.begin(), first_chunk.end()));
+    check (!validator.feed(second_chunk.begin(), second_chunk.end()));
+    counted = thread_statistics() - before;
+    check (counted[statistics::incomplete_sequence_errors] == 1);
+    check (counted[statistics::invalid_lead_errors] == 0);
+    check (counted[statistics::decoded_length_1] == 1);
+}
+
+// Runs of every kind of sequence, long enough for the bulk kernels
+string long_text(bool broken)
+{
+    string text;
+    for (int i = 0; i < 200; ++i) {
+        text += "The quick brown fox jumps over the lazy dog ";
+        text += sample;
+        if (broken && i % 50 == 49)
+            text += "\xe6\x41";
+    }
+    return text;
+}
+
+// Raw pointers take the bulk kernels and deques the per-sequence code;
+// the counts must come out the same
+template <typename operation, typename units>
+void compare_counts(operation op, const units& input, const char* name)
+{
+    typedef typename units::value_type unit;
+    vector<unit> raw(input.begin(), input.end());
+    deque<unit> other(input.begin(), input.end());
+    statistics before = thread_statistics();
+    op(raw.data(), raw.data() + raw.size());
+    const statistics bulk = thread_statistics() - before;
+    before = thread_statistics();
+    op(other.begin(), other.end());
+    const statistics counted = thread_statistics() - before;
+    for (int c = 0; c < statistics::counter_count; ++c) {
+        const statistics::counter which = static_cast<statistics::counter>(c);
+        if (bulk[which] != counted[which])
+            cout << "Counts differ: " << name << ' ' << statistics::name(which) << ' '
+                 << bulk[which] << ' ' << counted[which] << '\n';
+    }
+}
+
+struct validate_all {
+    template <typename iterator> void operator () (iterator first, iterator last) const { check (is_valid(first, last)); }
+};
+
+struct count_all {
+    template <typename iterator> void operator () (iterator first, iterator last) const { utf8::distance(first, last); }
+};
+
+struct advance_all {
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        utf8::advance(first, utf8::unchecked::distance(first, last), last);
+        unchecked::advance(first, 0);
+    }
+};
+
+struct utf16_length {
+    template <typename iterator> void operator () (iterator first, iterator last) const { utf8to16_length(first, last); }
+};
+
+struct to_utf16 {
+    bool checked;
+    explicit to_utf16(bool checked) : checked(checked) {}
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        vector<uint16_t> units(10000);
+        if (checked)
+            utf8to16(first, last, &units[0]);
+        else
+            unchecked::utf8to16(first, last, &units[0]);
+    }
+};
+
+struct to_utf32 {
+    bool checked;
+    explicit to_utf32(bool checked) : checked(checked) {}
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        vector<uint32_t> code_points(10000);
+        if (checked)
+            utf8to32(first, last, &code_points[0]);
+        else
+            unchecked::utf8to32(first, last, &code_points[0]);
+    }
+};
+
+// The same through an output iterator that is not a pointer, which takes
+// the scans for ASCII but not the copies
+struct insert_utf16 {
+    bool checked;
+    explicit insert_utf16(bool checked) : checked(checked) {}
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        vector<uint16_t> units;
+        if (checked)
+            utf8to16(first, last, back_inserter(units));
+        else
+            unchecked::utf8to16(first, last, back_inserter(units));
+    }
+};
+
+struct insert_utf32 {
+    bool checked;
+    explicit insert_utf32(bool checked) : checked(checked) {}
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        vector<uint32_t> code_points;
+        if (checked)
+            utf8to32(first, last, back_inserter(code_points));
+        else
+            unchecked::utf8to32(first, last, back_inserter(code_points));
+    }
+};
+
+struct from_utf16 {
+    bool checked;
+    explicit from_utf16(bool checked) : checked(checked) {}
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        string octets(40000, 0);
+        if (checked)
+            utf16to8(first, last, &octets[0]);
+        else
+            unchecked::utf16to8(first, last, &octets[0]);
+    }
+};
+
+struct from_utf32 {
+    bool checked;
+    explicit from_utf32(bool checked) : checked(checked) {}
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        string octets(40000, 0);
+        if (checked)
+            utf32to8(first, last, &octets[0]);
+        else
+            unchecked::utf32to8(first, last, &octets[0]);
+    }
+};
+
+struct replace_all {
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        string octets(20000, 0);
+        replace_invalid(first, last, &octets[0]);
+    }
+};
+
+struct decode_bounded {
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        vector<uint16_t> units(3000);
+        conversion_result<iterator, uint16_t*> result = utf8to16_bounded(first, last, &units[0], units.size());
+        while (result.status == conversion_output_full)
+            result = utf8to16_bounded(result.in, last, &units[0], units.size());
+    }
+};
+
+struct decode_stream {
+    stream_mode mode;
+    explicit decode_stream(stream_mode mode) : mode(mode) {}
+    template <typename iterator> void operator () (iterator first, iterator last) const
+    {
+        // units as wide as the mode writes, for the bulk kernels
+        vector<uint16_t> utf16(20000);
+        vector<uint32_t> utf32(20000);
+        string octets(20000, 0);
+        stream_decoder decoder(mode);
+        if (mode == stream_utf16)
+            decoder.feed(first, last, &utf16[0]);
+        else if (mode == stream_utf32)
+            decoder.feed(first, last, &utf32[0]);
+        else
+            decoder.feed(first, last, &octets[0]);
+    }
+};
+
+void test_bulk()
+{
+    const string text = long_text(false);
+    compare_counts(validate_all(), text, "is_valid");
+    compare_counts(count_all(), text, "distance");
+    compare_counts(advance_all(), text, "advance");
+    compare_counts(utf16_length(), text, "utf8to16_length");
+    compare_counts(to_utf16(true), text, "utf8to16");
+    compare_counts(to_utf16(false), text, "unchecked::utf8to16");
+    compare_counts(to_utf32(true), text, "utf8to32");
+    compare_counts(to_utf32(false), text, "unchecked::utf8to32");
+    compare_counts(insert_utf16(true), text, "utf8to16 into back_inserter");
+    compare_counts(insert_utf16(false), text, "unchecked::utf8to16 into back_inserter");
+    compare_counts(insert_utf32(true), text, "utf8to32 into back_inserter");
+    compare_counts(insert_utf32(false), text, "unchecked::utf8to32 into back_inserter");
+    compare_counts(decode_stream(stream_utf16), text, "stream_decoder utf16");
+    compare_counts(decode_stream(stream_utf32), text, "stream_decoder utf32");
+
+    vector<uint16_t> utf16;
+    utf8to16(text.begin(), text.end(), back_inserter(utf16));
+    compare_counts(from_utf16(true), utf16, "utf16to8");
+    compare_counts(from_utf16(false), utf16, "unchecked::utf16to8");
+    vector<uint32_t> utf32;
+    utf8to32(text.begin(), text.end(), back_inserter(utf32));
+    compare_counts(from_utf32(true), utf32, "utf32to8");
+    compare_counts(from_utf32(false), utf32, "unchecked::utf32to8");
+
+    const string broken = long_text(true);
+    compare_counts(replace_all(), broken, "replace_invalid");
+    compare_counts(decode_bounded(), broken, "utf8to16_bounded");
+    compare_counts(decode_stream(stream_validate), broken, "stream_decoder validate");
+    compare_counts(decode_stream(stream_sanitize), broken, "stream_decoder sanitize");
+}
+
+void test_threads()
+{
+    statistics before = collect_statistics();
+    thread worker([] {
+        string text;
+        for (int i = 0; i < 1000; ++i)
+            text += sample;
+        check (utf8::distance(text.begin(), text.end()) == 4000);
+    });
+    worker.join();
+    // The worker has ended; its counts are kept
+    statistics counted = collect_statistics() - before;
+    check (counted[statistics::octets_decoded] == 10000);
+    check (counted[statistics::decoded_length_4] == 1000);
+    // and the ones of this thread are still in
+    check (collect_statistics()[statistics::octets_decoded] >= thread_statistics()[statistics::octets_decoded] + 10000);
+    check (string(statistics::name(statistics::replacements)) == "replacements");
+}
+
+int main()
+{
+    test_decoding();
+    test_encoding();
+    test_errors();
+    test_bulk();
+    test_threads();
+}
@@ -1,10 +1,12 @@
 #include "../../source/utf8.h"
+#include "../../source/utf8/file.h"
 using namespace utf8;
 
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <iterator>
 using namespace std;
 
 const unsigned INVALID_LINES[] = { 75, 76, 83, 84, 85, 93, 102, 103, 105, 106, 107, 108, 109, 110, 114, 115, 116, 117, 124, 125, 130, 135, 140, 145, 153, 154, 155, 156, 157, 158, 159, 160, 161, 162, 169, 175, 176, 177, 207, 208, 209, 210, 211, 220, 221, 222, 223, 224, 232, 233, 234, 235, 236, 247, 248, 249, 250, 251, 252, 253, 257, 258, 259, 260, 261, 262, 263, 264};
@@ -50,4 +52,12 @@ int main(int argc, char** argv)
         else if (!expected_valid)
             cout << "Invalid utf-8 NOT detected at line " << line_count << '\n';
     }
+
+    // The first invalid octet of the whole file, found in its mapping
+    ifstream whole_file(test_file_path.c_str(), ios::in | ios::binary);
+    const string contents((istreambuf_iterator<char>(whole_file)), istreambuf_iterator<char>());
+    if (file::find_invalid(test_file_path.c_str()) != size_t(find_invalid(contents.begin(), contents.end()) - contents.begin()))
+        cout << "Error in file::find_invalid" << '\n';
+    if (file::is_valid(test_file_path.c_str()))
+        cout << "Invalid utf-8 NOT detected in the file" << '\n';
 }
@@ -0,0 +1,567 @@
+// Throughput of the library operations on UTF-8 text.
+//
+//   benchmark [--repetitions N] [--warmup N] [--filter TEXT] [--json FILE]
+//             [--baseline FILE] [--tolerance PERCENT]
+//             [--generate PROFILE|all] [--size OCTETS] [--seed N]
+//             [--invalid RATE] [file...]
+//
+// The text comes from files and from the synthetic corpora of corpus.h,
+// by profile; --size, --seed and --invalid apply to all of them. Invalid
+// text is validated as it is and converted with the invalid sequences
+// replaced.
+//
+// Every operation is timed over the whole text of each input: a few warmup
+// rounds first, then a number of repetitions, each long enough for the
+// clock to resolve. The median and the best repetition are reported in
+// GB/s of UTF-8 text (for the conversions from UTF-16 and UTF-32 too) and
+// in cycles per octet of the time stamp counter where there is one.
+//
+// --json writes the results in a form --baseline reads back; against a
+// baseline, operations whose median throughput fell by more than the
+// tolerance (5% by default) are listed and the exit status is 1.
+
+#include "../../source/utf8.h"
+#include "corpus.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define BENCHMARK_CYCLES
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define BENCHMARK_CYCLES
+#endif
+
+// The conversions of the operating system, for reference
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <iconv.h>
+#define BENCHMARK_ICONV
+#endif
+
+using namespace std;
+
+namespace {
+
+// Results are added up here, so that the work cannot be optimized away
+volatile size_t sink;
+
+const double min_repetition_seconds = 0.01;
+
+unsigned long long cycle_count()
+{
+#ifdef BENCHMARK_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+double seconds_since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+struct settings {
+    unsigned repetitions;
+    unsigned warmup;
+    double tolerance;
+    string filter;
+    string json;
+    string baseline;
+    vector<string> files;
+    vector<corpus::profile> profiles;
+    size_t corpus_octets;
+    unsigned seed;
+    double invalid_rate;
+};
+
+struct result {
+    string operation;
+    string input;
+    size_t octets;
+    unsigned iterations;
+    double median_ns;           // one call, over the whole input
+    double best_ns;
+    double cycles_per_octet;    // median, 0 without a cycle counter
+
+    double median_gbps() const { return octets / median_ns; }
+    double best_gbps() const { return octets / best_ns; }
+};
+
+struct operation {
+    string name;
+    size_t octets;              // of the UTF-8 text it works on
+    function<size_t()> call;
+
+    operation(const string& name, size_t octets, const function<size_t()>& call) :
+        name(name), octets(octets), call(call) {}
+};
+
+typedef vector<operation> operation_list;
+
+result measure(const string& operation, const string& input, size_t octets,
+               const function<size_t()>& call, const settings& options)
+{
+    // A first call tells how many make a repetition long enough to time
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    sink += call();
+    const double once = seconds_since(start);
+    const unsigned iterations = once >= min_repetition_seconds ? 1 :
+        static_cast<unsigned>(min_repetition_seconds / max(once, 1e-9)) + 1;
+
+    for (unsigned w = 0; w < options.warmup; ++w)
+        for (unsigned i = 0; i < iterations; ++i)
+            sink += call();
+
+    vector<double> nanoseconds, cycles;
+    for (unsigned r = 0; r < options.repetitions; ++r) {
+        start = chrono::steady_clock::now();
+        const unsigned long long first_cycle = cycle_count();
+        for (unsigned i = 0; i < iterations; ++i)
+            sink += call();
+        const unsigned long long last_cycle = cycle_count();
+        nanoseconds.push_back(seconds_since(start) * 1e9 / iterations);
+        cycles.push_back(static_cast<double>(last_cycle - first_cycle) / iterations);
+    }
+    sort(nanoseconds.begin(), nanoseconds.end());
+    sort(cycles.begin(), cycles.end());
+
+    result measured;
+    measured.operation = operation;
+    measured.input = input;
+    measured.octets = octets;
+    measured.iterations = iterations;
+    measured.median_ns = nanoseconds[nanoseconds.size() / 2];
+    measured.best_ns = nanoseconds.front();
+    measured.cycles_per_octet = cycles[cycles.size() / 2] / octets;
+    return measured;
+}
+
+// The text and the buffers the operations read and write
+struct workload {
+    string raw;                 // as read or generated
+    string text;                // with the invalid sequences replaced
+    vector<uint16_t> utf16;
+    vector<uint32_t> utf32;
+    vector<char> octets;
+    vector<uint16_t> units16;
+    vector<uint32_t> units32;
+    size_t code_points;
+
+    explicit workload(const string& utf8_text) : raw(utf8_text)
+    {
+        utf8::replace_invalid(raw.begin(), raw.end(), back_inserter(text));
+        utf8::utf8to16(text.begin(), text.end(), back_inserter(utf16));
+        utf8::utf8to32(text.begin(), text.end(), back_inserter(utf32));
+        // room for replace_invalid on the raw text too
+        octets.resize(max(text.size(), 3 * raw.size()) + 1);
+        units16.resize(utf16.size() + 1);
+        units32.resize(utf32.size() + 1);
+        code_points = utf32.size();
+    }
+
+    const char* begin() const { return text.data(); }
+    const char* end() const { return text.data() + text.size(); }
+    const char* raw_begin() const { return raw.data(); }
+    const char* raw_end() const { return raw.data() + raw.size(); }
+};
+
+operation_list checked_operations(workload& w)
+{
+    const char* b = w.begin();
+    const char* e = w.end();
+    const char* raw_b = w.raw_begin();
+    const char* raw_e = w.raw_end();
+    const size_t n = w.text.size();
+    operation_list operations;
+    operations.push_back(operation("is_valid", w.raw.size(), [=] { return size_t(utf8::is_valid(raw_b, raw_e)); }));
+    operations.push_back(operation("find_invalid", w.raw.size(), [=] {
+        return size_t(utf8::find_invalid(raw_b, raw_e) - raw_b); }));
+    operations.push_back(operation("replace_invalid", w.raw.size(), [=, &w] {
+        return size_t(utf8::replace_invalid(raw_b, raw_e, &w.octets[0]) - &w.octets[0]); }));
+    operations.push_back(operation("distance", n, [=] { return size_t(utf8::distance(b, e)); }));
+    operations.push_back(operation("advance", n, [=, &w] {
+        const char* it = b;
+        utf8::advance(it, w.code_points, e);
+        return size_t(it - b); }));
+    operations.push_back(operation("next", n, [=] {
+        size_t sum = 0;
+        for (const char* it = b; it != e; )
+            sum += utf8::next(it, e);
+        return sum; }));
+    operations.push_back(operation("prior", n, [=] {
+        size_t sum = 0;
+        for (const char* it = e; it != b; )
+            sum += utf8::prior(it, b);
+        return sum; }));
+    operations.push_back(operation("iterator", n, [=] {
+        size_t sum = 0;
+        for (utf8::iterator<const char*> it(b, b, e), end(e, b, e); it != end; ++it)
+            sum += *it;
+        return sum; }));
+    operations.push_back(operation("cached_iterator", n, [=] {
+        size_t sum = 0;
+        for (utf8::cached_iterator<const char*> it(b, b, e), end(e, b, e); it != end; ++it)
+            sum += *it;
+        return sum; }));
+    operations.push_back(operation("validated_view", n, [=] {
+        size_t sum = 0;
+        utf8::validated_view<const char*> view(b, e);
+        for (utf8::validated_view<const char*>::iterator it = view.begin(); it != view.end(); ++it)
+            sum += *it;
+        return sum; }));
+    operations.push_back(operation("block_decoder", n, [=] {
+        size_t sum = 0;
+        utf8::block_decoder<const char*> blocks(b, e);
+        while (blocks.next())
+            for (const uint32_t* cp = blocks.begin(); cp != blocks.end(); ++cp)
+                sum += *cp;
+        return sum; }));
+    operations.push_back(operation("utf8to16_length", n, [=] { return size_t(utf8::utf8to16_length(b, e)); }));
+    operations.push_back(operation("utf16to8_length", n, [&w] {
+        return size_t(utf8::utf16to8_length(w.utf16.data(), w.utf16.data() + w.utf16.size())); }));
+    operations.push_back(operation("utf32to8_length", n, [&w] {
+        return size_t(utf8::utf32to8_length(w.utf32.data(), w.utf32.data() + w.utf32.size())); }));
+    operations.push_back(operation("utf8to16", n, [=, &w] {
+        return size_t(utf8::utf8to16(b, e, &w.units16[0]) - &w.units16[0]); }));
+    operations.push_back(operation("utf8to32", n, [=, &w] {
+        return size_t(utf8::utf8to32(b, e, &w.units32[0]) - &w.units32[0]); }));
+    operations.push_back(operation("utf16to8", n, [&w] {
+        return size_t(utf8::utf16to8(w.utf16.data(), w.utf16.data() + w.utf16.size(), &w.octets[0]) - &w.octets[0]); }));
+    operations.push_back(operation("utf32to8", n, [&w] {
+        return size_t(utf8::utf32to8(w.utf32.data(), w.utf32.data() + w.utf32.size(), &w.octets[0]) - &w.octets[0]); }));
+    return operations;
+}
+
+operation_list unchecked_operations(workload& w)
+{
+    const char* b = w.begin();
+    const char* e = w.end();
+    const size_t n = w.text.size();
+    operation_list operations;
+    operations.push_back(operation("unchecked::distance", n, [=] { return size_t(utf8::unchecked::distance(b, e)); }));
+    operations.push_back(operation("unchecked::advance", n, [=, &w] {
+        const char* it = b;
+        utf8::unchecked::advance(it, w.code_points);
+        return size_t(it - b); }));
+    operations.push_back(operation("unchecked::next", n, [=] {
+        size_t sum = 0;
+        for (const char* it = b; it != e; )
+            sum += utf8::unchecked::next(it);
+        return sum; }));
+    operations.push_back(operation("unchecked::prior", n, [=] {
+        size_t sum = 0;
+        for (const char* it = e; it != b; )
+            sum += utf8::unchecked::prior(it);
+        return sum; }));
+    operations.push_back(operation("unchecked::iterator", n, [=] {
+        size_t sum = 0;
+        for (utf8::unchecked::iterator<const char*> it(b), end(e); it != end; ++it)
+            sum += *it;
+        return sum; }));
+    operations.push_back(operation("unchecked::cached_iterator", n, [=] {
+        size_t sum = 0;
+        for (utf8::unchecked::cached_iterator<const char*> it(b, e), end(e, e); it != end; ++it)
+            sum += *it;
+        return sum; }));
+    operations.push_back(operation("unchecked::utf8to16_length", n, [=] {
+        return size_t(utf8::unchecked::utf8to16_length(b, e)); }));
+    operations.push_back(operation("unchecked::utf16to8_length", n, [&w] {
+        return size_t(utf8::unchecked::utf16to8_length(w.utf16.data(), w.utf16.data() + w.utf16.size())); }));
+    operations.push_back(operation("unchecked::utf32to8_length", n, [&w] {
+        return size_t(utf8::unchecked::utf32to8_length(w.utf32.data(), w.utf32.data() + w.utf32.size())); }));
+    operations.push_back(operation("unchecked::utf8to16", n, [=, &w] {
+        return size_t(utf8::unchecked::utf8to16(b, e, &w.units16[0]) - &w.units16[0]); }));
+    operations.push_back(operation("unchecked::utf8to32", n, [=, &w] {
+        return size_t(utf8::unchecked::utf8to32(b, e, &w.units32[0]) - &w.units32[0]); }));
+    operations.push_back(operation("unchecked::utf16to8", n, [&w] {
+        return size_t(utf8::unchecked::utf16to8(w.utf16.data(), w.utf16.data() + w.utf16.size(), &w.octets[0]) - &w.octets[0]); }));
+    operations.push_back(operation("unchecked::utf32to8", n, [&w] {
+        return size_t(utf8::unchecked::utf32to8(w.utf32.data(), w.utf32.data() + w.utf32.size(), &w.octets[0]) - &w.octets[0]); }));
+    return operations;
+}
+
+operation_list reference_operations(workload& w)
+{
+    const size_t n = w.text.size();
+    operation_list operations;
+#if defined(BENCHMARK_ICONV)
+    operations.push_back(operation("iconv::utf8to16", n, [&w] {
+        iconv_t cd = iconv_open("UTF-16LE", "UTF-8");
+        char* in = const_cast<char*>(w.text.data());
+        size_t in_left = w.text.size();
+        char* out = reinterpret_cast<char*>(&w.units16[0]);
+        size_t out_left = w.units16.size() * sizeof(uint16_t);
+        iconv(cd, &in, &in_left, &out, &out_left);
+        iconv_close(cd);
+        return out_left; }));
+    operations.push_back(operation("iconv::utf16to8", n, [&w] {
+        iconv_t cd = iconv_open("UTF-8", "UTF-16LE");
+        char* in = reinterpret_cast<char*>(w.utf16.data());
+        size_t in_left = w.utf16.size() * sizeof(uint16_t);
+        char* out = &w.octets[0];
+        size_t out_left = w.octets.size();
+        iconv(cd, &in, &in_left, &out, &out_left);
+        iconv_close(cd);
+        return out_left; }));
+#elif defined(_WIN32)
+    operations.push_back(operation("win32::utf8to16", n, [&w] {
+        return size_t(MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, w.text.data(), int(w.text.size()),
+                                          reinterpret_cast<wchar_t*>(&w.units16[0]), int(w.units16.size()))); }));
+    operations.push_back(operation("win32::utf16to8", n, [&w] {
+        return size_t(WideCharToMultiByte(CP_UTF8, 0, reinterpret_cast<const wchar_t*>(w.utf16.data()), int(w.utf16.size()),
+                                          &w.octets[0], int(w.octets.size()), NULL, NULL)); }));
+#else
+    (void)w;
+    (void)n;
+#endif
+    return operations;
+}
+
+const char* simd_level_name(utf8::simd_level level)
+{
+    switch (level) {
+        case utf8::simd_sse2: return "sse2";
+        case utf8::simd_sse42: return "sse4.2";
+        case utf8::simd_avx2: return "avx2";
+        case utf8::simd_avx512bw: return "avx512bw";
+        default: return "scalar";
+    }
+}
+
+string json_string(const string& s)
+{
+    string quoted = "\"";
+    for (string::const_iterator c = s.begin(); c != s.end(); ++c) {
+        if (*c == '"' || *c == '\\')
+            quoted += '\\';
+        quoted += *c;
+    }
+    return quoted + "\"";
+}
+
+void write_json(const string& path, const vector<result>& results)
+{
+    ofstream json(path.c_str());
+    json << "{\n  \"simd_level\": " << json_string(simd_level_name(utf8::simd_level_in_use())) << ",\n";
+    json << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const result& r = results[i];
+        // One result a line; read_baseline depends on it
+        json << "    {\"operation\": " << json_string(r.operation) << ", \"input\": " << json_string(r.input)
+             << ", \"octets\": " << r.octets << ", \"iterations\": " << r.iterations
+             << ", \"median_ns\": " << r.median_ns << ", \"best_ns\": " << r.best_ns
+             << ", \"median_gbps\": " << r.median_gbps() << ", \"best_gbps\": " << r.best_gbps()
+             << ", \"cycles_per_octet\": " << r.cycles_per_octet << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+}
+
+// The value of a field of a result line of write_json
+bool json_field(const string& line, const string& name, string& value)
+{
+    const string key = "\"" + name + "\": ";
+    size_t at = line.find(key);
+    if (at == string::npos)
+        return false;
+    at += key.size();
+    value.clear();
+    if (line[at] != '"') {
+        value = line.substr(at, line.find_first_of(",}", at) - at);
+        return true;
+    }
+    for (++at; at < line.size() && line[at] != '"'; ++at) {
+        if (line[at] == '\\')
+            ++at;
+        value += line[at];
+    }
+    return true;
+}
+
+map<pair<string, string>, double> read_baseline(const string& path)
+{
+    map<pair<string, string>, double> baseline;
+    ifstream json(path.c_str());
+    if (!json.is_open())
+        cout << "Could not open " << path << endl;
+    string line, name, input, gbps;
+    while (getline(json, line))
+        if (json_field(line, "operation", name) && json_field(line, "input", input) &&
+            json_field(line, "median_gbps", gbps))
+            baseline[make_pair(name, input)] = atof(gbps.c_str());
+    return baseline;
+}
+
+// Returns the number of operations slower than the baseline allows
+int compare(const vector<result>& results, const string& path, double tolerance)
+{
+    const map<pair<string, string>, double> baseline = read_baseline(path);
+    int regressions = 0;
+    printf("\n%-28s %-28s %10s %10s %8s\n", "operation", "input", "baseline", "GB/s", "change");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const result& r = results[i];
+        map<pair<string, string>, double>::const_iterator old = baseline.find(make_pair(r.operation, r.input));
+        if (old == baseline.end() || old->second <= 0)
+            continue;
+        const double change = (r.median_gbps() / old->second - 1) * 100;
+        const bool regression = change < -tolerance;
+        regressions += regression;
+        printf("%-28s %-28s %10.3f %10.3f %+7.1f%%%s\n", r.operation.c_str(), r.input.c_str(),
+               old->second, r.median_gbps(), change, regression ? "  slower" : "");
+    }
+    return regressions;
+}
+
+bool read_file(const string& path, string& text)
+{
+    ifstream file(path.c_str(), ios::binary);
+    if (!file.is_open())
+        return false;
+    ostringstream content;
+    content << file.rdbuf();
+    text = content.str();
+    return true;
+}
+
+string file_name(const string& path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+bool parse_arguments(int argc, char** argv, settings& options)
+{
+    options.repetitions = 11;
+    options.warmup = 2;
+    options.tolerance = 5;
+    options.corpus_octets = 1 << 22;
+    options.seed = 1;
+    options.invalid_rate = 0;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--repetitions" && has_value)
+            options.repetitions = max(1, atoi(argv[++i]));
+        else if (arg == "--warmup" && has_value)
+            options.warmup = max(0, atoi(argv[++i]));
+        else if (arg == "--tolerance" && has_value)
+            options.tolerance = atof(argv[++i]);
+        else if (arg == "--filter" && has_value)
+            options.filter = argv[++i];
+        else if (arg == "--json" && has_value)
+            options.json = argv[++i];
+        else if (arg == "--baseline" && has_value)
+            options.baseline = argv[++i];
+        else if (arg == "--generate" && has_value) {
+            const string name = argv[++i];
+            corpus::profile kind;
+            if (name == "all")
+                for (int p = 0; p < corpus::profile_count; ++p)
+                    options.profiles.push_back(static_cast<corpus::profile>(p));
+            else if (corpus::find_profile(name, kind))
+                options.profiles.push_back(kind);
+            else
+                return false;
+        }
+        else if (arg == "--size" && has_value)
+            options.corpus_octets = strtoul(argv[++i], NULL, 10);
+        else if (arg == "--seed" && has_value)
+            options.seed = static_cast<unsigned>(strtoul(argv[++i], NULL, 10));
+        else if (arg == "--invalid" && has_value)
+            options.invalid_rate = atof(argv[++i]);
+        else if (arg.compare(0, 2, "--") == 0)
+            return false;
+        else
+            options.files.push_back(arg);
+    }
+    return !options.files.empty() || !options.profiles.empty();
+}
+
+// The name of a generated input in the results, e.g. cjk-4194304 or
+// mixed-1048576-seed7-invalid0.001
+string corpus_name(corpus::profile kind, const settings& options)
+{
+    ostringstream name;
+    name << corpus::profile_names[kind] << '-' << options.corpus_octets;
+    if (options.seed != 1)
+        name << "-seed" << options.seed;
+    if (options.invalid_rate > 0)
+        name << "-invalid" << options.invalid_rate;
+    return name.str();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    settings options;
+    if (!parse_arguments(argc, argv, options)) {
+        cout << "\nUsage: benchmark [--repetitions N] [--warmup N] [--filter TEXT] [--json FILE]\n"
+                "                 [--baseline FILE] [--tolerance PERCENT]\n"
+                "                 [--generate PROFILE|all] [--size OCTETS] [--seed N]\n"
+                "                 [--invalid RATE] [file...]\n"
+                "Profiles: ascii, latin1, cyrillic, cjk, emoji, mixed\n";
+        return 2;
+    }
+
+    printf("SIMD level: %s\n", simd_level_name(utf8::simd_level_in_use()));
+    printf("%-28s %-28s %10s %10s %8s\n", "operation", "input", "median", "best", "cycles");
+    printf("%-28s %-28s %10s %10s %8s\n", "", "", "GB/s", "GB/s", "/octet");
+    vector<pair<string, string> > inputs;
+    for (size_t f = 0; f < options.files.size(); ++f) {
+        string text;
+        if (!read_file(options.files[f], text)) {
+            cout << "Could not open " << options.files[f] << endl;
+            return 2;
+        }
+        inputs.push_back(make_pair(file_name(options.files[f]), text));
+    }
+    for (size_t p = 0; p < options.profiles.size(); ++p)
+        inputs.push_back(make_pair(corpus_name(options.profiles[p], options),
+                                   corpus::generate(options.profiles[p], options.corpus_octets,
+                                                    options.seed, options.invalid_rate).utf8));
+
+    vector<result> results;
+    for (size_t in = 0; in < inputs.size(); ++in) {
+        if (inputs[in].second.empty())
+            continue;
+
+        workload w(inputs[in].second);
+        operation_list operations = checked_operations(w);
+        const operation_list unchecked = unchecked_operations(w);
+        const operation_list reference = reference_operations(w);
+        operations.insert(operations.end(), unchecked.begin(), unchecked.end());
+        operations.insert(operations.end(), reference.begin(), reference.end());
+
+        const string& input = inputs[in].first;
+        for (size_t i = 0; i < operations.size(); ++i) {
+            if (operations[i].name.find(options.filter) == string::npos)
+                continue;
+            const result r = measure(operations[i].name, input, operations[i].octets, operations[i].call, options);
+            printf("%-28s %-28s %10.3f %10.3f %8.2f\n", r.operation.c_str(), r.input.c_str(),
+                   r.median_gbps(), r.best_gbps(), r.cycles_per_octet);
+            results.push_back(r);
+        }
+    }
+
+    if (!options.json.empty())
+        write_json(options.json, results);
+    if (!options.baseline.empty() && compare(results, options.baseline, options.tolerance) > 0)
+        return 1;
+    return 0;
+}
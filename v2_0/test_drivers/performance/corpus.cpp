@@ -0,0 +1,63 @@
+// Writes a synthetic corpus (see corpus.h) in UTF-8, UTF-16LE and UTF-32LE:
+//
+//   corpus [--seed N] [--invalid RATE] [--output NAME] profile octets
+//
+// to NAME.utf8, NAME.utf16le and NAME.utf32le; NAME is the profile by
+// default. The same arguments always give the same files.
+
+#include "corpus.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+template <typename unit>
+bool write_le(const string& path, const vector<unit>& units)
+{
+    vector<char> octets;
+    octets.reserve(units.size() * sizeof(unit));
+    for (size_t i = 0; i < units.size(); ++i)
+        for (size_t octet = 0; octet < sizeof(unit); ++octet)
+            octets.push_back(static_cast<char>(units[i] >> (8 * octet)));
+    ofstream file(path.c_str(), ios::binary);
+    file.write(octets.data(), octets.size());
+    return file.good();
+}
+
+int main(int argc, char** argv)
+{
+    unsigned seed = 1;
+    double invalid_rate = 0;
+    string name;
+    vector<string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc)
+            seed = static_cast<unsigned>(strtoul(argv[++i], NULL, 10));
+        else if (arg == "--invalid" && i + 1 < argc)
+            invalid_rate = atof(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            name = argv[++i];
+        else
+            positional.push_back(arg);
+    }
+
+    corpus::profile kind;
+    if (positional.size() != 2 || !corpus::find_profile(positional[0], kind)) {
+        cout << "\nUsage: corpus [--seed N] [--invalid RATE] [--output NAME] profile octets\n"
+                "Profiles: ascii, latin1, cyrillic, cjk, emoji, mixed\n";
+        return 2;
+    }
+    if (name.empty())
+        name = positional[0];
+
+    const corpus::text text = corpus::generate(kind, strtoul(positional[1].c_str(), NULL, 10), seed, invalid_rate);
+    ofstream utf8_file((name + ".utf8").c_str(), ios::binary);
+    utf8_file.write(text.utf8.data(), text.utf8.size());
+    if (!utf8_file.good() || !write_le(name + ".utf16le", text.utf16) || !write_le(name + ".utf32le", text.utf32)) {
+        cout << "Could not write " << name << ".*\n";
+        return 1;
+    }
+    cout << name << ": " << text.utf8.size() << " octets, " << text.utf32.size() << " code points\n";
+    return 0;
+}
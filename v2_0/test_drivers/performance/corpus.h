@@ -0,0 +1,209 @@
+// Synthetic text for the benchmarks and for stress runs: words, sentences
+// and paragraphs in a given script, generated from a seed so that every run
+// sees the same input. The profiles are
+//
+//   ascii      English-like text
+//   latin1     Western European text, with a letter in six from Latin-1
+//   cyrillic   Russian- and Greek-like text, two octets a letter
+//   cjk        Chinese- and Japanese-like text, three octets a character
+//   emoji      chat-like text in which every other word is a run of emoji
+//   mixed      a script of the above chosen anew for every sentence
+//
+// Invalid sequences can be inserted at a given rate per code point. The
+// UTF-16 and UTF-32 forms hold the same code points, without them.
+
+#ifndef UTF8_FOR_CPP_CORPUS_H
+#define UTF8_FOR_CPP_CORPUS_H
+
+#include "../../source/utf8.h"
+#include <string>
+#include <vector>
+
+namespace corpus {
+
+enum profile { ascii, latin1, cyrillic, cjk, emoji, mixed };
+
+const char* const profile_names[] = {"ascii", "latin1", "cyrillic", "cjk", "emoji", "mixed"};
+const int profile_count = 6;
+
+// Returns false for a name that is not a profile
+inline bool find_profile(const std::string& name, profile& kind)
+{
+    for (int i = 0; i < profile_count; ++i)
+        if (name == profile_names[i]) {
+            kind = static_cast<profile>(i);
+            return true;
+        }
+    return false;
+}
+
+struct text {
+    std::string utf8;
+    std::vector<uint16_t> utf16;
+    std::vector<uint32_t> utf32;
+};
+
+// xorshift64*: corpora run to hundreds of megabytes, longer than the
+// period of the generator of the bulk test
+class random_source {
+    unsigned long long state;
+public:
+    explicit random_source(unsigned seed) : state(seed * 0x9e3779b97f4a7c15ull + 1) {}
+    unsigned operator () (unsigned n)
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<unsigned>(((state * 0x2545f4914f6cdd1dull) >> 32) % n);
+    }
+    bool chance(double p) { return (*this)(1000000) < p * 1000000; }
+};
+
+class generator {
+    text& out;
+    size_t octets;
+    double invalid_rate;
+    random_source rnd;
+
+    static const unsigned max_letters = 10;
+
+    uint32_t ascii_letter()
+    {
+        // roughly the frequencies of English
+        static const char letters[] = "eeeeeeeeeeeetttttttttaaaaaaaaooooooooiiiiiiinnnnnnnsssssshhhhhhrrrrrr"
+                                      "ddddllllcccuuummmwwffggyyppbbvkjxqz";
+        return static_cast<unsigned char>(letters[rnd(sizeof(letters) - 1)]);
+    }
+
+    uint32_t latin1_letter()
+    {
+        static const uint32_t accented[] = {0xe0, 0xe1, 0xe2, 0xe4, 0xe7, 0xe8, 0xe9, 0xea, 0xeb, 0xed,
+                                            0xee, 0xef, 0xf1, 0xf3, 0xf4, 0xf6, 0xf9, 0xfa, 0xfb, 0xfc, 0xdf};
+        return rnd(6) == 0 ? accented[rnd(sizeof(accented) / sizeof(accented[0]))] : ascii_letter();
+    }
+
+    uint32_t cyrillic_letter(bool greek)
+    {
+        if (greek) {
+            const uint32_t cp = 0x3b1 + rnd(0x18);
+            return cp == 0x3c2 ? 0x3c3 : cp;
+        }
+        return 0x430 + rnd(0x20);
+    }
+
+    uint32_t cjk_character()
+    {
+        // a hiragana in four, the rest ideographs
+        return rnd(4) == 0 ? 0x3041 + rnd(0x56) : 0x4e00 + rnd(0x5200);
+    }
+
+    uint32_t emoji_character()
+    {
+        static const uint32_t blocks[][2] = {{0x1f300, 0x300}, {0x1f600, 0x50}, {0x1f680, 0x80}, {0x1f900, 0x100}};
+        const uint32_t (&block)[2] = blocks[rnd(4)];
+        return block[0] + rnd(block[1]);
+    }
+
+    bool full() const { return out.utf8.size() >= octets; }
+
+    void put(uint32_t cp)
+    {
+        if (full())
+            return;
+        utf8::unchecked::append(cp, back_inserter(out.utf8));
+        out.utf32.push_back(cp);
+        if (cp > 0xffff) {
+            out.utf16.push_back(static_cast<uint16_t>((cp >> 10) + utf8::internal::LEAD_OFFSET));
+            out.utf16.push_back(static_cast<uint16_t>((cp & 0x3ff) + utf8::internal::TRAIL_SURROGATE_MIN));
+        }
+        else
+            out.utf16.push_back(static_cast<uint16_t>(cp));
+        if (invalid_rate > 0 && rnd.chance(invalid_rate))
+            put_invalid();
+    }
+
+    void put_invalid()
+    {
+        static const char* const bad_sequences[] = {
+            "\x80", "\xbf", "\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf", "\xe0\x9f\xbf",
+            "\xed\xa0\x80", "\xed\xbf\xbf", "\xf0\x80\x80\xaf", "\xf4\x90\x80\x80",
+            "\xf5\x80\x80\x80", "\xfe", "\xff", "\xc2", "\xe6\x97", "\xf0\x9d\x84"
+        };
+        out.utf8 += bad_sequences[rnd(sizeof(bad_sequences) / sizeof(bad_sequences[0]))];
+    }
+
+    void word(profile kind, bool capital, bool greek)
+    {
+        const unsigned letters = 1 + rnd(max_letters);
+        for (unsigned i = 0; i < letters; ++i) {
+            uint32_t cp = 0;
+            switch (kind) {
+                case latin1:   cp = latin1_letter(); break;
+                case cyrillic: cp = cyrillic_letter(greek); break;
+                case cjk:      cp = cjk_character(); break;
+                default:       cp = ascii_letter();
+            }
+            // the capitals of these letters are 0x20 below them
+            if (capital && i == 0 && kind != cjk && cp != 0xdf)
+                cp -= 0x20;
+            put(cp);
+        }
+    }
+
+    void sentence(profile kind)
+    {
+        const bool greek = kind == cyrillic && rnd(4) == 0;
+        const unsigned words = 4 + rnd(16);
+        for (unsigned i = 0; i < words && !full(); ++i) {
+            if (kind == emoji && rnd(2) == 0) {
+                for (unsigned e = 1 + rnd(3); e > 0; --e)
+                    put(emoji_character());
+            }
+            else
+                word(kind, i == 0, greek);
+            // no spaces between words in Chinese and Japanese
+            if (kind == cjk) {
+                if (i + 1 == words)
+                    put(0x3002);
+                else if (rnd(4) == 0)
+                    put(0x3001);
+            }
+            else if (i + 1 == words)
+                put(rnd(8) == 0 ? '?' : '.');
+            else {
+                if (rnd(10) == 0)
+                    put(',');
+                put(' ');
+            }
+        }
+    }
+
+public:
+    generator(text& out, size_t octets, unsigned seed, double invalid_rate) :
+        out(out), octets(octets), invalid_rate(invalid_rate), rnd(seed) {}
+
+    void run(profile kind)
+    {
+        while (!full()) {
+            for (unsigned sentences = 1 + rnd(8); sentences > 0 && !full(); --sentences) {
+                sentence(kind == mixed ? static_cast<profile>(rnd(mixed)) : kind);
+                if (kind != cjk)
+                    put(' ');
+            }
+            put('\n');
+        }
+    }
+};
+
+// Text of at least the given number of octets
+inline text generate(profile kind, size_t octets, unsigned seed = 1, double invalid_rate = 0)
+{
+    text generated;
+    generated.utf8.reserve(octets + 4);
+    generator(generated, octets, seed, invalid_rate).run(kind);
+    return generated;
+}
+
+} // namespace corpus
+
+#endif // header guard
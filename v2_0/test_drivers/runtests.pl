@@ -48,3 +48,20 @@ chdir '..';
 die if !open(REPORT, ">>$report_name");
 print REPORT "==================End of utf8reader runs==================\n";
 print REPORT "\n";
+print REPORT "==================Bulk Test ==================\n";
+close($report_name);
+chdir 'bulk';
+`./bulktest >> ../$report_name`;
+`./bulktest_native >> ../$report_name`;
+chdir '..';
+die if !open(REPORT, ">>$report_name");
+print REPORT "==================End of bulk test==================\n";
+print REPORT "\n";
+print REPORT "==================Instrumentation Test ==================\n";
+close($report_name);
+chdir 'instrument';
+`./instrumenttest >> ../$report_name`;
+chdir '..';
+die if !open(REPORT, ">>$report_name");
+print REPORT "==================End of instrumentation test==================\n";
+print REPORT "\n";
@@ -1,10 +1,19 @@
 #include <cstring>
 #include <cassert>
 #include <vector>
+#include <algorithm>
 #include "../../source/utf8.h"
+#ifdef UTF8_CPP_CPP11
+#include "../../source/utf8/parallel.h"
+#endif
 using namespace utf8;
 using namespace std;
 
+bool is_cyrillic(uint32_t cp)
+{
+    return cp >= 0x0400 && cp <= 0x04ff;
+}
+
 int main()
 {
     //append
@@ -128,6 +137,63 @@ int main()
     unsigned short* utf16_end = utf8to16 (utf8_with_surrogates, utf8_with_surrogates + 9, &utf16result[0]);
     assert (utf16_end == &utf16result[0] + 4);
 
+    // conversion lengths
+    assert (utf8to16_length(utf8_with_surrogates, utf8_with_surrogates + 9) == 4);
+    assert (utf8to32_length(utf8_with_surrogates, utf8_with_surrogates + 9) == 3);
+    assert (utf16to8_length(utf16string, utf16string + 5) == 10);
+    assert (utf32to8_length(utf32string, utf32string + 3) == 9);
+#ifdef UTF8_CPP_CPP11
+    u16string u16 = utf8to16(string(utf8_with_surrogates));
+    assert (u16 == u"\x65e5\x0448\xd834\xdd1e");
+    assert (utf16to8(u16) == utf8_with_surrogates);
+    u32string u32 = utf8to32(string(utf8_with_surrogates));
+    assert (u32 == U"\x65e5\x0448\x1d11e");
+    assert (utf32to8(u32) == utf8_with_surrogates);
+    unsigned short parallel16[4];
+    assert (parallel::utf8to16(utf8_with_surrogates, utf8_with_surrogates + 9, parallel16, 3) == parallel16 + 4);
+    assert (parallel16[0] == 0x65e5 && parallel16[3] == 0xdd1e);
+    assert (parallel::find_invalid(utf8_with_surrogates, utf8_with_surrogates + 8, 2) == utf8_with_surrogates + 5);
+#endif
+
+    // bounded conversions
+    unsigned short bounded16[4];
+    conversion_result<char*, unsigned short*> to16 = utf8to16_bounded(utf8_with_surrogates, utf8_with_surrogates + 9, bounded16, 3);
+    assert (to16.status == conversion_output_full && to16.in == utf8_with_surrogates + 5);
+    assert (to16.consumed == 5 && to16.written == 2 && to16.out == bounded16 + 2);
+    to16 = utf8to16_bounded(to16.in, utf8_with_surrogates + 9, to16.out, 2);
+    assert (to16.status == conversion_ok && to16.out == bounded16 + 4 && bounded16[3] == 0xdd1e);
+    to16 = utf8to16_bounded(utf8_with_surrogates, utf8_with_surrogates + 8, bounded16, 4);
+    assert (to16.status == conversion_incomplete && to16.in == utf8_with_surrogates + 5);
+    char bounded8[10];
+    conversion_result<unsigned short*, char*> to8 = utf16to8_bounded(utf16string, utf16string + 5, bounded8, 9);
+    assert (to8.status == conversion_output_full && to8.consumed == 3 && to8.written == 6);
+    to8 = utf16to8_bounded(utf16string, utf16string + 4, bounded8, 10);
+    assert (to8.status == conversion_incomplete && to8.in == utf16string + 3);
+    int invalid_utf32[] = {0x41, 0xd800};
+    conversion_result<int*, char*> from32 = utf32to8_bounded(invalid_utf32, invalid_utf32 + 2, bounded8, 10);
+    assert (from32.status == conversion_invalid_code_point && from32.in == invalid_utf32 + 1 && from32.written == 1);
+
+    // stream decoding, with sequences split between chunks
+    stream_decoder to16_stream(stream_utf16);
+    unsigned short streamed16[4];
+    unsigned short* streamed16_end = to16_stream.feed(utf8_with_surrogates, utf8_with_surrogates + 2, streamed16);
+    assert (streamed16_end == streamed16 && to16_stream.pending() == 2);
+    streamed16_end = to16_stream.feed(utf8_with_surrogates + 2, utf8_with_surrogates + 6, streamed16_end);
+    assert (streamed16_end == streamed16 + 2 && to16_stream.pending() == 1);
+    streamed16_end = to16_stream.feed(utf8_with_surrogates + 6, utf8_with_surrogates + 9, streamed16_end);
+    assert (to16_stream.finish(streamed16_end) == streamed16 + 4 && streamed16[1] == 0x0448 && streamed16[3] == 0xdd1e);
+    stream_decoder validator;
+    assert (validator.feed(utf8_with_surrogates, utf8_with_surrogates + 8) && validator.pending() == 3);
+    assert (!validator.finish() && !validator.valid());
+    validator.reset();
+    assert (validator.feed(utf8_with_surrogates, utf8_with_surrogates + 9) && validator.finish());
+    char split_invalid[] = "\xe6\x97" "A\xfa";
+    stream_decoder sanitizer(stream_sanitize);
+    string sanitized;
+    sanitizer.feed(split_invalid, split_invalid + 2, back_inserter(sanitized));
+    sanitizer.feed(split_invalid + 2, split_invalid + 4, back_inserter(sanitized));
+    assert (sanitized == "\xef\xbf\xbd" "A\xef\xbf\xbd" && !sanitizer.valid());
+
     //find_invalid
     char utf_invalid[] = "\xe6\x97\xa5\xd1\x88\xfa";
     char* invalid = find_invalid(utf_invalid, utf_invalid + 6);
@@ -139,6 +205,29 @@ int main()
     bvalid = is_valid(utf8_with_surrogates, utf8_with_surrogates + 9);
     assert (bvalid == true);
 
+    // long ASCII runs around multi-octet sequences
+    const char long_ascii[] = "The quick brown fox jumps over the lazy dog \xd1\x88 The quick brown fox jumps over the lazy dog\xfa";
+    const char* long_ascii_end = long_ascii + sizeof(long_ascii) - 1;
+    assert (find_invalid(long_ascii, long_ascii_end) == long_ascii_end - 1);
+    assert (!is_valid(long_ascii, long_ascii_end));
+    assert (is_valid(long_ascii, long_ascii_end - 1));
+    vector<unsigned short> long_utf16;
+    utf8to16(long_ascii, long_ascii_end - 1, back_inserter(long_utf16));
+    assert (long_utf16.size() == 89 && long_utf16[43] == 0x20 && long_utf16[44] == 0x0448 && long_utf16[88] == 'g');
+    vector<int> long_utf32;
+    utf8to32(long_ascii, long_ascii_end - 1, back_inserter(long_utf32));
+    assert (long_utf32.size() == 89 && long_utf32[44] == 0x0448 && long_utf32[88] == 'g');
+    assert (utf8::distance(long_ascii, long_ascii_end - 1) == 89);
+
+    // simd levels
+    simd_level level_in_use = simd_level_in_use();
+    assert (level_in_use <= supported_simd_level());
+    assert (set_simd_level(simd_scalar) == simd_scalar && simd_level_in_use() == simd_scalar);
+    assert (find_invalid(long_ascii, long_ascii_end) == long_ascii_end - 1);
+    assert (utf8::distance(long_ascii, long_ascii_end - 1) == 89);
+    assert (set_simd_level(simd_avx512bw) == supported_simd_level());
+    set_simd_level(level_in_use);
+
     //starts_with_bom
     unsigned char byte_order_mark[] = {0xef, 0xbb, 0xbf};
     bool bbom = starts_with_bom(byte_order_mark, byte_order_mark + sizeof(byte_order_mark));
@@ -157,8 +246,11 @@ int main()
     replace_invalid (invalid_sequence, invalid_sequence + sizeof(invalid_sequence), replace_invalid_result.begin(), '?');
     bvalid = is_valid(replace_invalid_result.begin(), replace_invalid_result.end());
     assert (bvalid);
-    const char* fixed_invalid_sequence = "a????z";
+    const char fixed_invalid_sequence[] = "a????z";
     assert (std::equal(replace_invalid_result.begin(), replace_invalid_result.begin() + sizeof(fixed_invalid_sequence), fixed_invalid_sequence));
+    vector<char> long_replace_result;
+    replace_invalid (long_ascii, long_ascii_end, back_inserter(long_replace_result), '?');
+    assert (long_replace_result.size() == 91 && long_replace_result[44] == '\xd1' && long_replace_result[90] == '?');
 
     // iterator
     utf8::iterator<const char*> it(threechars, threechars, threechars + 9);
@@ -177,6 +269,60 @@ int main()
     assert (--it == utf8::iterator<const char*>(threechars, threechars, threechars + 9));
     assert (*it == 0x10346);
 
+    // cached iterator
+    cached_iterator<const char*> cached_it(threechars, threechars, threechars + 9);
+    cached_iterator<const char*> cached_end(threechars + 9, threechars, threechars + 9);
+    assert (*cached_it == 0x10346 && *cached_it == 0x10346);
+    assert (*(++cached_it) == 0x65e5);
+    assert ((*cached_it++) == 0x65e5);
+    assert (*cached_it == 0x0448 && cached_it.base() == threechars + 7);
+    assert (++cached_it == cached_end);
+    assert (*(--cached_it) == 0x0448);
+    assert ((*cached_it--) == 0x0448);
+    assert (*cached_it == 0x65e5 && *--cached_it == 0x10346);
+    cached_iterator<const char*> cached_begin(threechars, threechars, threechars + 9);
+    assert (find_if(cached_begin, cached_end, is_cyrillic).base() == threechars + 7);
+    assert (std::distance(cached_begin, cached_end) == 3);
+    std::advance(cached_it, 2);
+    assert (*cached_it == 0x0448);
+    bool cached_threw = false;
+    try {
+        cached_iterator<const char*> at_invalid(utf_invalid + 5, utf_invalid, utf_invalid + 6);
+    }
+    catch (const invalid_utf8&) {
+        cached_threw = true;
+    }
+    assert (cached_threw);
+
+    // validated views
+    validated_view<const char*> view(threechars, threechars + 9);
+    assert (view.size() == 3 && !view.empty());
+    validated_view<const char*>::iterator view_it = view.begin();
+    assert (*view_it == 0x10346 && *++view_it == 0x65e5 && *++view_it == 0x0448 && ++view_it == view.end());
+    assert (*--view_it == 0x0448 && view_it.base() == threechars + 7);
+    bool view_threw = false;
+    try {
+        make_validated_view(utf_invalid, utf_invalid + 6);
+    }
+    catch (const invalid_utf8&) {
+        view_threw = true;
+    }
+    assert (view_threw);
+    unsigned short surrogates16[] = {0x65e5, 0xd834, 0xdd1e, 0x0448};
+    validated_view16<unsigned short*> view16 = make_validated_view16(surrogates16, surrogates16 + 4);
+    assert (view16.size() == 3);
+    validated_view16<unsigned short*>::iterator view16_it = view16.begin();
+    assert (*view16_it == 0x65e5 && *++view16_it == 0x1d11e && *++view16_it == 0x0448 && ++view16_it == view16.end());
+    assert (*--view16_it == 0x0448 && *--view16_it == 0x1d11e && view16_it.base() == surrogates16 + 1);
+    view_threw = false;
+    try {
+        make_validated_view16(surrogates16 + 2, surrogates16 + 4);
+    }
+    catch (const invalid_utf16&) {
+        view_threw = true;
+    }
+    assert (view_threw);
+
     //////////////////////////////////////////////////////////
     //// Unchecked variants
     //////////////////////////////////////////////////////////
@@ -275,7 +421,21 @@ int main()
     // try it with the return value;
     utf16_end = utf8to16 (utf8_with_surrogates, utf8_with_surrogates + 9, &utf16result[0]);
     assert (utf16_end == &utf16result[0] + 4);
+
+    // conversion lengths
+    assert (unchecked::utf8to16_length(utf8_with_surrogates, utf8_with_surrogates + 9) == 4);
+    assert (unchecked::utf8to32_length(utf8_with_surrogates, utf8_with_surrogates + 9) == 3);
+    assert (unchecked::utf16to8_length(utf16string, utf16string + 5) == 10);
+    assert (unchecked::utf32to8_length(utf32string, utf32string + 3) == 9);
     
+    // long ASCII runs
+    long_utf16.clear();
+    unchecked::utf8to16(long_ascii, long_ascii_end - 1, back_inserter(long_utf16));
+    assert (long_utf16.size() == 89 && long_utf16[44] == 0x0448 && long_utf16[88] == 'g');
+    long_utf32.clear();
+    unchecked::utf8to32(long_ascii, long_ascii_end - 1, back_inserter(long_utf32));
+    assert (long_utf32.size() == 89 && long_utf32[44] == 0x0448 && long_utf32[88] == 'g');
+
     // iterator
     utf8::unchecked::iterator<const char*> un_it(threechars);
     utf8::unchecked::iterator<const char*> un_it2 = un_it;
@@ -292,6 +452,15 @@ int main()
     assert (*un_it == 0x65e5);
     assert (--un_it == utf8::unchecked::iterator<const char*>(threechars));
     assert (*un_it == 0x10346);
+
+    // cached iterator
+    unchecked::cached_iterator<const char*> un_cached_it(threechars, threechars + 9);
+    unchecked::cached_iterator<const char*> un_cached_end(threechars + 9, threechars + 9);
+    assert (*un_cached_it == 0x10346 && *++un_cached_it == 0x65e5 && *++un_cached_it == 0x0448);
+    assert (++un_cached_it == un_cached_end && *--un_cached_it == 0x0448 && *--un_cached_it == 0x65e5);
+    unchecked::cached_iterator<const char*> un_cached_begin(threechars, threechars + 9);
+    assert (find_if(un_cached_begin, un_cached_end, is_cyrillic).base() == threechars + 7);
+    assert (std::distance(un_cached_begin, un_cached_end) == 3);
 }
 
 
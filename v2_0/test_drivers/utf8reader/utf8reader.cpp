@@ -1,12 +1,22 @@
 #include "../../source/utf8.h"
+#include "../../source/utf8/file.h"
 using namespace utf8;
 
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
 using namespace std;
 
+string file_contents(const char* path)
+{
+    mapped_file file(path);
+    return string(file.begin(), file.end());
+}
+
 int main(int argc, char** argv)
 {
     if (argc != 2) {
@@ -37,24 +47,43 @@ int main(int argc, char** argv)
         if (line_end != line.end()) 
             cout << "Line " << line_count << ": Invalid utf-8 at byte " << int(line.end() - line_end) << '\n';
 
-        // Convert it to utf-16 and write to the file
-        vector<unsigned short> utf16_line;
-        utf8to16(line_start, line_end, back_inserter(utf16_line));
+        // Convert it to utf-16, into a vector sized up front
+        vector<unsigned short> utf16_line(utf8to16_length(line_start, line_end));
+        if (utf8to16(line_start, line_end, utf16_line.begin()) != utf16_line.end())
+            cout << "Line " << line_count << ": Error in utf8to16_length" << '\n';
 
         // Back to utf-8 and compare it to the original line.
-        string back_to_utf8;
-        utf16to8(utf16_line.begin(), utf16_line.end(), back_inserter(back_to_utf8));
+        string back_to_utf8(utf16to8_length(utf16_line.begin(), utf16_line.end()), ' ');
+        if (utf16to8(utf16_line.begin(), utf16_line.end(), back_to_utf8.begin()) != back_to_utf8.end())
+            cout << "Line " << line_count << ": Error in utf16to8_length" << '\n';
         if (back_to_utf8.compare(string(line_start, line_end)) != 0) 
             cout << "Line " << line_count << ": Conversion to UTF-16 and back failed" << '\n';
 
         // Now, convert it to utf-32, back to utf-8 and compare
-        vector <unsigned> utf32_line;
-        utf8to32(line_start, line_end, back_inserter(utf32_line));
-        back_to_utf8.clear();
-        utf32to8(utf32_line.begin(), utf32_line.end(), back_inserter(back_to_utf8));
+        vector <unsigned> utf32_line(utf8to32_length(line_start, line_end));
+        if (utf8to32(line_start, line_end, utf32_line.begin()) != utf32_line.end())
+            cout << "Line " << line_count << ": Error in utf8to32_length" << '\n';
+        back_to_utf8.assign(utf32to8_length(utf32_line.begin(), utf32_line.end()), ' ');
+        if (utf32to8(utf32_line.begin(), utf32_line.end(), back_to_utf8.begin()) != back_to_utf8.end())
+            cout << "Line " << line_count << ": Error in utf32to8_length" << '\n';
         if (back_to_utf8.compare(string(line_start, line_end)) != 0) 
             cout << "Line " << line_count << ": Conversion to UTF-32 and back failed" << '\n';
 
+#ifdef UTF8_CPP_CPP11
+        // The same, a whole string at a time
+        const string valid_line(line_start, line_end);
+        const u16string whole_utf16 = utf8to16(valid_line);
+        if (whole_utf16.size() != utf16_line.size() || !equal(utf16_line.begin(), utf16_line.end(), whole_utf16.begin()))
+            cout << "Line " << line_count << ": Error in utf8to16 of a string" << '\n';
+        if (utf16to8(whole_utf16) != valid_line)
+            cout << "Line " << line_count << ": Error in utf16to8 of a string" << '\n';
+        const u32string whole_utf32 = utf8to32(valid_line);
+        if (whole_utf32.size() != utf32_line.size() || !equal(utf32_line.begin(), utf32_line.end(), whole_utf32.begin()))
+            cout << "Line " << line_count << ": Error in utf8to32 of a string" << '\n';
+        if (utf32to8(whole_utf32) != valid_line)
+            cout << "Line " << line_count << ": Error in utf32to8 of a string" << '\n';
+#endif
+
         // Now, iterate and back
         unsigned char_count = 0;
         string::iterator it = line_start;
@@ -96,26 +125,30 @@ int main(int argc, char** argv)
 
         //======================== Now, the unchecked versions ======================
         // Convert it to utf-16 and compare to the checked version
-        vector<unsigned short> utf16_line_unchecked;
-        unchecked::utf8to16(line_start, line_end, back_inserter(utf16_line_unchecked));
+        vector<unsigned short> utf16_line_unchecked(unchecked::utf8to16_length(line_start, line_end));
+        if (unchecked::utf8to16(line_start, line_end, utf16_line_unchecked.begin()) != utf16_line_unchecked.end())
+            cout << "Line " << line_count << ": Error in unchecked::utf8to16_length" << '\n';
 
         if (utf16_line != utf16_line_unchecked)
             cout << "Line " << line_count << ": Error in unchecked::utf8to16" << '\n';
 
         // Back to utf-8 and compare it to the original line.
-        back_to_utf8.clear();
-        unchecked::utf16to8(utf16_line_unchecked.begin(), utf16_line_unchecked.end(), back_inserter(back_to_utf8));
+        back_to_utf8.assign(unchecked::utf16to8_length(utf16_line_unchecked.begin(), utf16_line_unchecked.end()), ' ');
+        if (unchecked::utf16to8(utf16_line_unchecked.begin(), utf16_line_unchecked.end(), back_to_utf8.begin()) != back_to_utf8.end())
+            cout << "Line " << line_count << ": Error in unchecked::utf16to8_length" << '\n';
         if (back_to_utf8.compare(string(line_start, line_end)) != 0) 
             cout << "Line " << line_count << ": Unchecked conversion to UTF-16 and back failed" << '\n';
 
         // Now, convert it to utf-32, back to utf-8 and compare
-        vector <unsigned> utf32_line_unchecked;
-        unchecked::utf8to32(line_start, line_end, back_inserter(utf32_line_unchecked));
+        vector <unsigned> utf32_line_unchecked(unchecked::utf8to32_length(line_start, line_end));
+        if (unchecked::utf8to32(line_start, line_end, utf32_line_unchecked.begin()) != utf32_line_unchecked.end())
+            cout << "Line " << line_count << ": Error in unchecked::utf8to32_length" << '\n';
         if (utf32_line != utf32_line_unchecked)
             cout << "Line " << line_count << ": Error in unchecked::utf8to32" << '\n';
 
-        back_to_utf8.clear();
-        unchecked::utf32to8(utf32_line.begin(), utf32_line.end(), back_inserter(back_to_utf8));
+        back_to_utf8.assign(unchecked::utf32to8_length(utf32_line.begin(), utf32_line.end()), ' ');
+        if (unchecked::utf32to8(utf32_line.begin(), utf32_line.end(), back_to_utf8.begin()) != back_to_utf8.end())
+            cout << "Line " << line_count << ": Error in unchecked::utf32to8_length" << '\n';
         if (back_to_utf8.compare(string(line_start, line_end)) != 0) 
             cout << "Line " << line_count << ": Unchecked conversion to UTF-32 and back failed" << '\n';
 
@@ -157,4 +190,71 @@ int main(int argc, char** argv)
         if (un_u8it != utf8::unchecked::iterator<string::iterator>(line_end))
           cout << "Line " << line_count << ": Error in using utf::unchecked::iterator with std::advance" << '\n';
     }
+
+    //======================== The whole file, mapped ======================
+    ifstream whole_file(TEST_FILE_PATH, ios::in | ios::binary);
+    const string contents((istreambuf_iterator<char>(whole_file)), istreambuf_iterator<char>());
+    mapped_file mapped(TEST_FILE_PATH);
+    if (string(mapped.begin(), mapped.end()) != contents)
+        cout << "Error in mapped_file" << '\n';
+    const size_t valid_size = file::find_invalid(TEST_FILE_PATH);
+    if (valid_size != size_t(find_invalid(contents.begin(), contents.end()) - contents.begin()))
+        cout << "Error in file::find_invalid" << '\n';
+    if (file::is_valid(TEST_FILE_PATH) != (valid_size == contents.size()))
+        cout << "Error in file::is_valid" << '\n';
+    if (valid_size != contents.size())
+        return 0;
+    if (file::distance(TEST_FILE_PATH) != size_t(utf8::distance(contents.begin(), contents.end())))
+        cout << "Error in file::distance" << '\n';
+
+    // Convert it to files of utf-16 and utf-32, and back
+    const char* utf16_path = "utf8reader.utf16.tmp";
+    const char* utf32_path = "utf8reader.utf32.tmp";
+    const char* back_path = "utf8reader.utf8.tmp";
+    if (file::utf8to16(TEST_FILE_PATH, utf16_path) != size_t(utf8to16_length(contents.begin(), contents.end())))
+        cout << "Error in file::utf8to16" << '\n';
+    if (file::utf16to8(utf16_path, back_path) != contents.size())
+        cout << "Error in file::utf16to8" << '\n';
+    {
+        mapped_file back(back_path);
+        if (string(back.begin(), back.end()) != contents)
+            cout << "File conversion to UTF-16 and back failed" << '\n';
+    }
+    if (file::utf8to32(TEST_FILE_PATH, utf32_path) != size_t(utf8::distance(contents.begin(), contents.end())))
+        cout << "Error in file::utf8to32" << '\n';
+    if (file::utf32to8(utf32_path, back_path) != contents.size())
+        cout << "Error in file::utf32to8" << '\n';
+    {
+        mapped_file back(back_path);
+        if (string(back.begin(), back.end()) != contents)
+            cout << "File conversion to UTF-32 and back failed" << '\n';
+    }
+#ifdef UTF8_CPP_MMAP
+    // A file is not converted onto itself, which would truncate the input
+    // as it is read
+    {
+        const string utf16_contents = file_contents(utf16_path);
+        bool refused = false;
+        try {
+            file::utf8to16(back_path, back_path);
+        }
+        catch (const file_error&) {
+            refused = true;
+        }
+        if (!refused || file_contents(back_path) != contents)
+            cout << "Error in file::utf8to16 onto its input" << '\n';
+        refused = false;
+        try {
+            file::utf16to8(utf16_path, utf16_path);
+        }
+        catch (const file_error&) {
+            refused = true;
+        }
+        if (!refused || file_contents(utf16_path) != utf16_contents)
+            cout << "Error in file::utf16to8 onto its input" << '\n';
+    }
+#endif
+    remove(utf16_path);
+    remove(utf32_path);
+    remove(back_path);
 }
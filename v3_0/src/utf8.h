@@ -34,16 +34,41 @@ DEALINGS IN THE SOFTWARE.
 // #define UTF_CPP_NO_STD_STRING
 // #define UTF_CPP_NO_EXCEPTIONS
 
+#include <cstddef>
+#include <iterator>
+
 #ifndef UTF_CPP_NO_EXCEPTIONS
 #include <stdexcept>
 
 #ifndef UTF_CPP_NO_STD_STRING
 #include <string>
-#include <iterator>
 
 #endif // #ifndef UTF_CPP_NO_STD_STRING
 #endif // #ifndef UTF_CPP_NO_EXCEPTIONS
 
+// Contiguous input can also be passed as std::string_view, std::u16string_view
+// and std::u32string_view (C++17), and output written to a std::span (C++20)
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define UTF_CPP_STRING_VIEW
+#include <string_view>
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#define UTF_CPP_SPAN
+#include <span>
+#endif
+#endif
+
+// The encoding, decoding and validation functions are constexpr from C++14
+// on, and UTF-8 literals can be checked at compile time from C++20 on
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#define UTF_CPP_CONSTEXPR constexpr
+#else
+#define UTF_CPP_CONSTEXPR
+#endif
+#if defined(__cpp_consteval) && defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+#define UTF_CPP_CONSTEVAL
+#include <array>
+#endif
+
 namespace utf8
 {
 
@@ -65,6 +90,27 @@ public:
     char32_t code_point() const {return cp;}
 };
 
+class invalid_utf8 : public exception {
+    unsigned char u8;
+public:
+    invalid_utf8(unsigned char u) : u8(u) {}
+    virtual const char* what() const noexcept { return "Invalid UTF-8"; }
+    unsigned char utf8_octet() const {return u8;}
+};
+
+class invalid_utf16 : public exception {
+    char16_t u16;
+public:
+    invalid_utf16(char16_t u) : u16(u) {}
+    virtual const char* what() const noexcept { return "Invalid UTF-16"; }
+    char16_t utf16_word() const {return u16;}
+};
+
+class not_enough_room : public exception {
+public:
+    virtual const char* what() const noexcept { return "Not enough space"; }
+};
+
 #endif // #ifndef UTF_CPP_NO_EXCEPTIONS
 
 // Helper code - not intended to be directly called by the library users. May be changed at any time
@@ -78,31 +124,136 @@ namespace internal
     const char32_t TRAIL_SURROGATE_MIN = 0x0000dc00;
     const char32_t TRAIL_SURROGATE_MAX = 0x0000dfff;
 
+    const char32_t LEAD_OFFSET         = LEAD_SURROGATE_MIN - (0x10000 >> 10);
+    const char32_t SURROGATE_OFFSET    = 0x10000u - (LEAD_SURROGATE_MIN << 10) - TRAIL_SURROGATE_MIN;
+
     // Maximum valid value for a Unicode code point
     const char32_t CODE_POINT_MAX      = 0x0010ffff;
 
+    template <typename octet_type>
+    UTF_CPP_CONSTEXPR inline unsigned char mask8(octet_type oc)
+    {
+        return static_cast<unsigned char>(0xff & oc);
+    }
+
+    template <typename u16_type>
+    UTF_CPP_CONSTEXPR inline char16_t mask16(u16_type oc)
+    {
+        return static_cast<char16_t>(0xffff & oc);
+    }
+
+    template <typename octet_type>
+    UTF_CPP_CONSTEXPR inline bool is_trail(octet_type oc)
+    {
+        return ((utf8::internal::mask8(oc) >> 6) == 0x2);
+    }
 
-    inline bool is_surrogate(char32_t cp)
+    UTF_CPP_CONSTEXPR inline bool is_lead_surrogate(char32_t cp)
+    {
+        return (cp >= LEAD_SURROGATE_MIN && cp <= LEAD_SURROGATE_MAX);
+    }
+
+    UTF_CPP_CONSTEXPR inline bool is_trail_surrogate(char32_t cp)
+    {
+        return (cp >= TRAIL_SURROGATE_MIN && cp <= TRAIL_SURROGATE_MAX);
+    }
+
+    UTF_CPP_CONSTEXPR inline bool is_surrogate(char32_t cp)
     {
         return (cp >= LEAD_SURROGATE_MIN && cp <= TRAIL_SURROGATE_MAX);
     }
 
-    inline bool is_code_point_valid(char32_t cp)
+    UTF_CPP_CONSTEXPR inline bool is_code_point_valid(char32_t cp)
     {
         return (cp <= CODE_POINT_MAX && !utf8::internal::is_surrogate(cp));
     }
-} // namespace internal
 
-    /// The library API - functions intended to be called by the users
+    // The length of the sequence a lead octet starts; 0 for an invalid lead
+    UTF_CPP_CONSTEXPR inline int sequence_length(unsigned char lead)
+    {
+        if (lead < 0x80)
+            return 1;
+        else if ((lead >> 5) == 0x6)
+            return 2;
+        else if ((lead >> 4) == 0xe)
+            return 3;
+        else if ((lead >> 3) == 0x1e)
+            return 4;
+        else
+            return 0;
+    }
+
+    UTF_CPP_CONSTEXPR inline bool is_overlong_sequence(char32_t cp, int length)
+    {
+        if (cp < 0x80)
+            return length != 1;
+        if (cp < 0x800)
+            return length != 2;
+        if (cp < 0x10000)
+            return length != 3;
+        return false;
+    }
 
+    // Decodes the sequence at it and moves it past the sequence. On failure
+    // it is left where it was; for INVALID_CODE_POINT, code_point is the
+    // value the sequence decodes to.
     template <typename octet_iterator>
-    octet_iterator append(char32_t cp, octet_iterator result, utf_error& error)
+    UTF_CPP_CONSTEXPR utf_error validate_next(octet_iterator& it, octet_iterator end, char32_t& code_point)
     {
-        if (!utf8::internal::is_code_point_valid(cp)) {
-            error = utf8::utf_error::INVALID_CODE_POINT;
-            return result;
+        if (it == end)
+            return utf_error::NOT_ENOUGH_ROOM;
+
+        octet_iterator original_it = it;
+        const int length = utf8::internal::sequence_length(utf8::internal::mask8(*it));
+        if (length == 0)
+            return utf_error::INVALID_LEAD;
+
+        // The payload bits of the lead octet, then six from each trail octet
+        char32_t cp = utf8::internal::mask8(*it) & (length == 1 ? 0x7f : 0x7f >> length);
+        utf_error err = utf_error::UTF8_OK;
+        for (int i = 1; i < length && err == utf_error::UTF8_OK; ++i) {
+            if (++it == end)
+                err = utf_error::NOT_ENOUGH_ROOM;
+            else if (!utf8::internal::is_trail(*it))
+                err = utf_error::INCOMPLETE_SEQUENCE;
+            else
+                cp = (cp << 6) | (utf8::internal::mask8(*it) & 0x3f);
         }
 
+        if (err == utf_error::UTF8_OK) {
+            if (!utf8::internal::is_code_point_valid(cp)) {
+                code_point = cp;
+                err = utf_error::INVALID_CODE_POINT;
+            }
+            else if (utf8::internal::is_overlong_sequence(cp, length))
+                err = utf_error::OVERLONG_SEQUENCE;
+            else {
+                code_point = cp;
+                ++it;
+                return utf_error::UTF8_OK;
+            }
+        }
+
+        it = original_it;
+        return err;
+    }
+
+    // Decodes a sequence known to be valid
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR char32_t next_unchecked(octet_iterator& it)
+    {
+        const int length = utf8::internal::sequence_length(utf8::internal::mask8(*it));
+        char32_t cp = utf8::internal::mask8(*it) & (length == 1 ? 0x7f : 0x7f >> length);
+        for (int i = 1; i < length; ++i)
+            cp = (cp << 6) | (utf8::internal::mask8(*++it) & 0x3f);
+        ++it;
+        return cp;
+    }
+
+    // Encodes a code point known to be valid
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR octet_iterator append_unchecked(char32_t cp, octet_iterator result)
+    {
         if (cp < 0x80)                        // one octet
             *(result++) = static_cast<char>(cp);
         else if (cp < 0x800) {                // two octets
@@ -123,12 +274,296 @@ namespace internal
         return result;
     }
 
+    template <typename u16bit_iterator>
+    UTF_CPP_CONSTEXPR u16bit_iterator append16_unchecked(char32_t cp, u16bit_iterator result)
+    {
+        if (cp > 0xffff) { //make a surrogate pair
+            *(result++) = static_cast<char16_t>((cp >> 10)   + LEAD_OFFSET);
+            *(result++) = static_cast<char16_t>((cp & 0x3ff) + TRAIL_SURROGATE_MIN);
+        }
+        else
+            *(result++) = static_cast<char16_t>(cp);
+        return result;
+    }
+
+    // Conversions of input known to be valid; the checked ones take the
+    // length of the result first, which validates it, and then fill it
+    template <typename octet_iterator, typename u16bit_iterator>
+    UTF_CPP_CONSTEXPR u16bit_iterator utf8to16_unchecked(octet_iterator start, octet_iterator end, u16bit_iterator result)
+    {
+        while (start != end)
+            result = utf8::internal::append16_unchecked(utf8::internal::next_unchecked(start), result);
+        return result;
+    }
+
+    template <typename octet_iterator, typename u32bit_iterator>
+    UTF_CPP_CONSTEXPR u32bit_iterator utf8to32_unchecked(octet_iterator start, octet_iterator end, u32bit_iterator result)
+    {
+        while (start != end)
+            *(result++) = utf8::internal::next_unchecked(start);
+        return result;
+    }
+
+    template <typename u16bit_iterator, typename octet_iterator>
+    UTF_CPP_CONSTEXPR octet_iterator utf16to8_unchecked(u16bit_iterator start, u16bit_iterator end, octet_iterator result)
+    {
+        while (start != end) {
+            char32_t cp = utf8::internal::mask16(*start++);
+            if (utf8::internal::is_lead_surrogate(cp))
+                cp = (cp << 10) + utf8::internal::mask16(*start++) + SURROGATE_OFFSET;
+            result = utf8::internal::append_unchecked(cp, result);
+        }
+        return result;
+    }
+
+    template <typename u32bit_iterator, typename octet_iterator>
+    UTF_CPP_CONSTEXPR octet_iterator utf32to8_unchecked(u32bit_iterator start, u32bit_iterator end, octet_iterator result)
+    {
+        while (start != end)
+            result = utf8::internal::append_unchecked(*(start++), result);
+        return result;
+    }
+} // namespace internal
+
+    /// The library API - functions intended to be called by the users
+
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR octet_iterator append(char32_t cp, octet_iterator result, utf_error& error)
+    {
+        if (!utf8::internal::is_code_point_valid(cp)) {
+            error = utf8::utf_error::INVALID_CODE_POINT;
+            return result;
+        }
+
+        return utf8::internal::append_unchecked(cp, result);
+    }
+
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR octet_iterator find_invalid(octet_iterator start, octet_iterator end)
+    {
+        char32_t ignored = 0;
+        while (start != end && utf8::internal::validate_next(start, end, ignored) == utf8::utf_error::UTF8_OK)
+            ;
+        return start;
+    }
+
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR inline bool is_valid(octet_iterator start, octet_iterator end)
+    {
+        return (utf8::find_invalid(start, end) == end);
+    }
+
+    // Versions of the functions that report errors instead of throwing, for
+    // builds without exceptions and for input that is often invalid. They
+    // stop at the first error and say where it is; the iterator functions
+    // leave the iterator there.
+    namespace nothrow
+    {
+        template <typename octet_iterator>
+        struct range_result {
+            octet_iterator in;          // the end, or the first invalid sequence
+            std::size_t offset;         // octets before in
+            std::size_t code_points;    // code points before in
+            utf_error error;
+        };
+
+        template <typename input_iterator, typename output_iterator>
+        struct conversion_result {
+            input_iterator in;          // the end, or the first invalid sequence
+            output_iterator out;        // past the last unit written
+            std::size_t offset;         // units of input before in
+            utf_error error;
+        };
+
+        /// On an error it is left at the invalid sequence, which is where
+        /// the error is
+        template <typename octet_iterator>
+        UTF_CPP_CONSTEXPR inline utf_error next(octet_iterator& it, octet_iterator end, char32_t& code_point)
+        {
+            return utf8::internal::validate_next(it, end, code_point);
+        }
+
+        /// Moves it back to the previous code point, no further than start.
+        /// Trail octets that no sequence takes, or a sequence that runs on
+        /// past it, are an INVALID_LEAD; NOT_ENOUGH_ROOM means it is at
+        /// start. On an error it is left where it was, at the end of the
+        /// invalid octets.
+        template <typename octet_iterator>
+        UTF_CPP_CONSTEXPR utf_error prior(octet_iterator& it, octet_iterator start, char32_t& code_point)
+        {
+            if (it == start)
+                return utf_error::NOT_ENOUGH_ROOM;
+            octet_iterator lead = it;
+            while (utf8::internal::is_trail(*(--lead)))
+                if (lead == start)
+                    return utf_error::INVALID_LEAD;
+            octet_iterator sequence_end = lead;
+            utf_error err = utf8::internal::validate_next(sequence_end, it, code_point);
+            if (err == utf_error::NOT_ENOUGH_ROOM || (err == utf_error::UTF8_OK && sequence_end != it))
+                err = utf_error::INVALID_LEAD;
+            if (err == utf_error::UTF8_OK)
+                it = lead;
+            return err;
+        }
+
+        /// On an error it is left at the invalid sequence, past the code
+        /// points it did move over
+        template <typename octet_iterator, typename distance_type>
+        UTF_CPP_CONSTEXPR utf_error advance(octet_iterator& it, distance_type n, octet_iterator end)
+        {
+            char32_t ignored = 0;
+            for (distance_type i = 0; i < n; ++i) {
+                const utf_error err = utf8::internal::validate_next(it, end, ignored);
+                if (err != utf_error::UTF8_OK)
+                    return err;
+            }
+            return utf_error::UTF8_OK;
+        }
+
+        template <typename octet_iterator>
+        UTF_CPP_CONSTEXPR range_result<octet_iterator> distance(octet_iterator first, octet_iterator last)
+        {
+            range_result<octet_iterator> result {first, 0, 0, utf_error::UTF8_OK};
+            char32_t ignored = 0;
+            while (result.in != last) {
+                const int length = utf8::internal::sequence_length(utf8::internal::mask8(*result.in));
+                result.error = utf8::internal::validate_next(result.in, last, ignored);
+                if (result.error != utf_error::UTF8_OK)
+                    break;
+                result.offset += length;
+                ++result.code_points;
+            }
+            return result;
+        }
+
+        template <typename octet_iterator>
+        UTF_CPP_CONSTEXPR inline range_result<octet_iterator> find_invalid(octet_iterator start, octet_iterator end)
+        {
+            return utf8::nothrow::distance(start, end);
+        }
+
+        /// Copies the input with each invalid sequence replaced, including
+        /// one cut off at the end. in is the end; error and offset tell
+        /// the first sequence replaced, if any. An invalid replacement is
+        /// an INVALID_CODE_POINT, with nothing written.
+        template <typename octet_iterator, typename output_iterator>
+        UTF_CPP_CONSTEXPR conversion_result<octet_iterator, output_iterator>
+        replace_invalid(octet_iterator start, octet_iterator end, output_iterator out, char32_t replacement = 0xfffd)
+        {
+            if (!utf8::internal::is_code_point_valid(replacement))
+                return {start, out, 0, utf_error::INVALID_CODE_POINT};
+
+            conversion_result<octet_iterator, output_iterator> result {end, out, 0, utf_error::UTF8_OK};
+            std::size_t offset = 0;
+            char32_t cp = 0;
+            while (start != end) {
+                octet_iterator sequence_start = start;
+                const utf_error err = utf8::internal::validate_next(start, end, cp);
+                if (err == utf_error::UTF8_OK) {
+                    for (; sequence_start != start; ++sequence_start, ++offset)
+                        *(result.out++) = *sequence_start;
+                    continue;
+                }
+                if (result.error == utf_error::UTF8_OK) {
+                    result.error = err;
+                    result.offset = offset;
+                }
+                result.out = utf8::internal::append_unchecked(replacement, result.out);
+                ++start;
+                ++offset;
+                // just one replacement mark for the sequence
+                if (err != utf_error::INVALID_LEAD)
+                    for (; start != end && utf8::internal::is_trail(*start); ++start)
+                        ++offset;
+            }
+            if (result.error == utf_error::UTF8_OK)
+                result.offset = offset;
+            return result;
+        }
+
+        template <typename octet_iterator, typename u16bit_iterator>
+        UTF_CPP_CONSTEXPR conversion_result<octet_iterator, u16bit_iterator>
+        utf8to16(octet_iterator start, octet_iterator end, u16bit_iterator result)
+        {
+            std::size_t offset = 0;
+            char32_t cp = 0;
+            while (start != end) {
+                const int length = utf8::internal::sequence_length(utf8::internal::mask8(*start));
+                const utf_error err = utf8::internal::validate_next(start, end, cp);
+                if (err != utf_error::UTF8_OK)
+                    return {start, result, offset, err};
+                offset += length;
+                result = utf8::internal::append16_unchecked(cp, result);
+            }
+            return {start, result, offset, utf_error::UTF8_OK};
+        }
+
+        template <typename octet_iterator, typename u32bit_iterator>
+        UTF_CPP_CONSTEXPR conversion_result<octet_iterator, u32bit_iterator>
+        utf8to32(octet_iterator start, octet_iterator end, u32bit_iterator result)
+        {
+            std::size_t offset = 0;
+            char32_t cp = 0;
+            while (start != end) {
+                const int length = utf8::internal::sequence_length(utf8::internal::mask8(*start));
+                const utf_error err = utf8::internal::validate_next(start, end, cp);
+                if (err != utf_error::UTF8_OK)
+                    return {start, result, offset, err};
+                offset += length;
+                *(result++) = cp;
+            }
+            return {start, result, offset, utf_error::UTF8_OK};
+        }
+
+        /// A lone trail surrogate is an INVALID_LEAD, and a lead surrogate
+        /// without a trail one an INCOMPLETE_SEQUENCE, or NOT_ENOUGH_ROOM
+        /// at the end of the input
+        template <typename u16bit_iterator, typename octet_iterator>
+        UTF_CPP_CONSTEXPR conversion_result<u16bit_iterator, octet_iterator>
+        utf16to8(u16bit_iterator start, u16bit_iterator end, octet_iterator result)
+        {
+            std::size_t offset = 0;
+            while (start != end) {
+                const u16bit_iterator unit = start;
+                char32_t cp = utf8::internal::mask16(*start++);
+                if (utf8::internal::is_lead_surrogate(cp)) {
+                    if (start == end)
+                        return {unit, result, offset, utf_error::NOT_ENOUGH_ROOM};
+                    const char32_t trail_surrogate = utf8::internal::mask16(*start);
+                    if (!utf8::internal::is_trail_surrogate(trail_surrogate))
+                        return {unit, result, offset, utf_error::INCOMPLETE_SEQUENCE};
+                    ++start;
+                    ++offset;
+                    cp = (cp << 10) + trail_surrogate + utf8::internal::SURROGATE_OFFSET;
+                }
+                else if (utf8::internal::is_trail_surrogate(cp))
+                    return {unit, result, offset, utf_error::INVALID_LEAD};
+                ++offset;
+                result = utf8::internal::append_unchecked(cp, result);
+            }
+            return {start, result, offset, utf_error::UTF8_OK};
+        }
+
+        template <typename u32bit_iterator, typename octet_iterator>
+        UTF_CPP_CONSTEXPR conversion_result<u32bit_iterator, octet_iterator>
+        utf32to8(u32bit_iterator start, u32bit_iterator end, octet_iterator result)
+        {
+            std::size_t offset = 0;
+            for (; start != end; ++start, ++offset) {
+                if (!utf8::internal::is_code_point_valid(*start))
+                    return {start, result, offset, utf_error::INVALID_CODE_POINT};
+                result = utf8::internal::append_unchecked(*start, result);
+            }
+            return {start, result, offset, utf_error::UTF8_OK};
+        }
+    } // namespace utf8::nothrow
+
 #ifndef UTF_CPP_NO_EXCEPTIONS
     template <typename octet_iterator>
-    octet_iterator append(char32_t cp, octet_iterator result)
+    UTF_CPP_CONSTEXPR octet_iterator append(char32_t cp, octet_iterator result)
     {
         utf8::utf_error err {utf8::utf_error::UTF8_OK};
-        utf8::append(cp, result, err);
+        result = utf8::append(cp, result, err);
         if (err != utf8::utf_error::UTF8_OK)
             throw utf8::invalid_code_point(cp);
 	return result;
@@ -139,7 +574,322 @@ namespace internal
         utf8::append(cp, std::back_inserter(str)); 
     }
 #endif // #ifndef UTF_CPP_NO_STD_STRING
+
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR char32_t next(octet_iterator& it, octet_iterator end)
+    {
+        char32_t cp = 0;
+        switch (utf8::internal::validate_next(it, end, cp)) {
+            case utf8::utf_error::UTF8_OK :
+                break;
+            case utf8::utf_error::NOT_ENOUGH_ROOM :
+                throw utf8::not_enough_room();
+            case utf8::utf_error::INVALID_LEAD :
+            case utf8::utf_error::INCOMPLETE_SEQUENCE :
+            case utf8::utf_error::OVERLONG_SEQUENCE :
+                throw utf8::invalid_utf8(utf8::internal::mask8(*it));
+            case utf8::utf_error::INVALID_CODE_POINT :
+                throw utf8::invalid_code_point(cp);
+        }
+        return cp;
+    }
+
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR typename std::iterator_traits<octet_iterator>::difference_type
+    distance(octet_iterator first, octet_iterator last)
+    {
+        typename std::iterator_traits<octet_iterator>::difference_type dist = 0;
+        for (; first != last; ++dist)
+            utf8::next(first, last);
+        return dist;
+    }
+
+    // The lengths of conversion results, in units of the target encoding;
+    // they check the input as the conversions do
+
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR typename std::iterator_traits<octet_iterator>::difference_type
+    utf8to16_length(octet_iterator start, octet_iterator end)
+    {
+        typename std::iterator_traits<octet_iterator>::difference_type length = 0;
+        while (start != end)
+            length += utf8::next(start, end) > 0xffff ? 2 : 1;
+        return length;
+    }
+
+    template <typename octet_iterator>
+    UTF_CPP_CONSTEXPR inline typename std::iterator_traits<octet_iterator>::difference_type
+    utf8to32_length(octet_iterator start, octet_iterator end)
+    {
+        return utf8::distance(start, end);
+    }
+
+    template <typename u16bit_iterator>
+    UTF_CPP_CONSTEXPR typename std::iterator_traits<u16bit_iterator>::difference_type
+    utf16to8_length(u16bit_iterator start, u16bit_iterator end)
+    {
+        typename std::iterator_traits<u16bit_iterator>::difference_type length = 0;
+        while (start != end) {
+            char32_t cp = utf8::internal::mask16(*start++);
+            if (utf8::internal::is_lead_surrogate(cp)) {
+                if (start == end)
+                    throw utf8::invalid_utf16(static_cast<char16_t>(cp));
+                const char16_t trail_surrogate = utf8::internal::mask16(*start++);
+                if (!utf8::internal::is_trail_surrogate(trail_surrogate))
+                    throw utf8::invalid_utf16(trail_surrogate);
+                length += 4;
+            }
+            else if (utf8::internal::is_trail_surrogate(cp))
+                throw utf8::invalid_utf16(static_cast<char16_t>(cp));
+            else
+                length += cp < 0x80 ? 1 : (cp < 0x800 ? 2 : 3);
+        }
+        return length;
+    }
+
+    template <typename u32bit_iterator>
+    UTF_CPP_CONSTEXPR typename std::iterator_traits<u32bit_iterator>::difference_type
+    utf32to8_length(u32bit_iterator start, u32bit_iterator end)
+    {
+        typename std::iterator_traits<u32bit_iterator>::difference_type length = 0;
+        for (; start != end; ++start) {
+            const char32_t cp = *start;
+            if (!utf8::internal::is_code_point_valid(cp))
+                throw utf8::invalid_code_point(cp);
+            length += cp < 0x80 ? 1 : (cp < 0x800 ? 2 : (cp < 0x10000 ? 3 : 4));
+        }
+        return length;
+    }
+
+    template <typename u16bit_iterator, typename octet_iterator>
+    UTF_CPP_CONSTEXPR u16bit_iterator utf8to16(octet_iterator start, octet_iterator end, u16bit_iterator result)
+    {
+        while (start != end)
+            result = utf8::internal::append16_unchecked(utf8::next(start, end), result);
+        return result;
+    }
+
+    template <typename octet_iterator, typename u32bit_iterator>
+    UTF_CPP_CONSTEXPR u32bit_iterator utf8to32(octet_iterator start, octet_iterator end, u32bit_iterator result)
+    {
+        while (start != end)
+            *(result++) = utf8::next(start, end);
+        return result;
+    }
+
+    template <typename u16bit_iterator, typename octet_iterator>
+    UTF_CPP_CONSTEXPR octet_iterator utf16to8(u16bit_iterator start, u16bit_iterator end, octet_iterator result)
+    {
+        while (start != end) {
+            char32_t cp = utf8::internal::mask16(*start++);
+            // Take care of surrogate pairs first
+            if (utf8::internal::is_lead_surrogate(cp)) {
+                if (start == end)
+                    throw utf8::invalid_utf16(static_cast<char16_t>(cp));
+                const char16_t trail_surrogate = utf8::internal::mask16(*start++);
+                if (!utf8::internal::is_trail_surrogate(trail_surrogate))
+                    throw utf8::invalid_utf16(trail_surrogate);
+                cp = (cp << 10) + trail_surrogate + utf8::internal::SURROGATE_OFFSET;
+            }
+            // Lone trail surrogate
+            else if (utf8::internal::is_trail_surrogate(cp))
+                throw utf8::invalid_utf16(static_cast<char16_t>(cp));
+
+            result = utf8::internal::append_unchecked(cp, result);
+        }
+        return result;
+    }
+
+    template <typename u32bit_iterator, typename octet_iterator>
+    UTF_CPP_CONSTEXPR octet_iterator utf32to8(u32bit_iterator start, u32bit_iterator end, octet_iterator result)
+    {
+        while (start != end)
+            result = utf8::append(*(start++), result);
+        return result;
+    }
+#endif // #ifndef UTF_CPP_NO_EXCEPTIONS
+
+#ifdef UTF_CPP_STRING_VIEW
+    // Overloads for contiguous input. They run the iterator functions on
+    // plain pointers; the conversions size their result from the length of
+    // the input, which checks it, and then fill it without further checks.
+
+    /// The offset of the first invalid octet, or std::string_view::npos
+    UTF_CPP_CONSTEXPR inline std::size_t find_invalid(std::string_view s)
+    {
+        const char* end = s.data() + s.size();
+        const char* invalid = utf8::find_invalid(s.data(), end);
+        return (invalid == end) ? std::string_view::npos : static_cast<std::size_t>(invalid - s.data());
+    }
+
+    UTF_CPP_CONSTEXPR inline bool is_valid(std::string_view s)
+    {
+        return utf8::is_valid(s.data(), s.data() + s.size());
+    }
+
+#ifndef UTF_CPP_NO_EXCEPTIONS
+    UTF_CPP_CONSTEXPR inline std::size_t distance(std::string_view s)
+    {
+        return static_cast<std::size_t>(utf8::distance(s.data(), s.data() + s.size()));
+    }
+
+    UTF_CPP_CONSTEXPR inline std::size_t utf8to16_length(std::string_view s)
+    {
+        return static_cast<std::size_t>(utf8::utf8to16_length(s.data(), s.data() + s.size()));
+    }
+
+    UTF_CPP_CONSTEXPR inline std::size_t utf8to32_length(std::string_view s)
+    {
+        return static_cast<std::size_t>(utf8::utf8to32_length(s.data(), s.data() + s.size()));
+    }
+
+    UTF_CPP_CONSTEXPR inline std::size_t utf16to8_length(std::u16string_view s)
+    {
+        return static_cast<std::size_t>(utf8::utf16to8_length(s.data(), s.data() + s.size()));
+    }
+
+    UTF_CPP_CONSTEXPR inline std::size_t utf32to8_length(std::u32string_view s)
+    {
+        return static_cast<std::size_t>(utf8::utf32to8_length(s.data(), s.data() + s.size()));
+    }
+
+#ifndef UTF_CPP_NO_STD_STRING
+    inline std::u16string utf8to16(std::string_view s)
+    {
+        std::u16string result(utf8::utf8to16_length(s), u'\0');
+        utf8::internal::utf8to16_unchecked(s.data(), s.data() + s.size(), result.data());
+        return result;
+    }
+
+    inline std::u32string utf8to32(std::string_view s)
+    {
+        std::u32string result(utf8::utf8to32_length(s), U'\0');
+        utf8::internal::utf8to32_unchecked(s.data(), s.data() + s.size(), result.data());
+        return result;
+    }
+
+    inline std::string utf16to8(std::u16string_view s)
+    {
+        std::string result(utf8::utf16to8_length(s), '\0');
+        utf8::internal::utf16to8_unchecked(s.data(), s.data() + s.size(), result.data());
+        return result;
+    }
+
+    inline std::string utf32to8(std::u32string_view s)
+    {
+        std::string result(utf8::utf32to8_length(s), '\0');
+        utf8::internal::utf32to8_unchecked(s.data(), s.data() + s.size(), result.data());
+        return result;
+    }
+#endif // #ifndef UTF_CPP_NO_STD_STRING
+
+#ifdef UTF_CPP_SPAN
+    // Conversions into a span the caller provides; they return the number
+    // of units written, and throw not_enough_room if the span is too small
+
+    UTF_CPP_CONSTEXPR inline std::size_t utf8to16(std::string_view s, std::span<char16_t> result)
+    {
+        const std::size_t length = utf8::utf8to16_length(s);
+        if (length > result.size())
+            throw utf8::not_enough_room();
+        utf8::internal::utf8to16_unchecked(s.data(), s.data() + s.size(), result.data());
+        return length;
+    }
+
+    UTF_CPP_CONSTEXPR inline std::size_t utf8to32(std::string_view s, std::span<char32_t> result)
+    {
+        const std::size_t length = utf8::utf8to32_length(s);
+        if (length > result.size())
+            throw utf8::not_enough_room();
+        utf8::internal::utf8to32_unchecked(s.data(), s.data() + s.size(), result.data());
+        return length;
+    }
+
+    UTF_CPP_CONSTEXPR inline std::size_t utf16to8(std::u16string_view s, std::span<char> result)
+    {
+        const std::size_t length = utf8::utf16to8_length(s);
+        if (length > result.size())
+            throw utf8::not_enough_room();
+        utf8::internal::utf16to8_unchecked(s.data(), s.data() + s.size(), result.data());
+        return length;
+    }
+
+    UTF_CPP_CONSTEXPR inline std::size_t utf32to8(std::u32string_view s, std::span<char> result)
+    {
+        const std::size_t length = utf8::utf32to8_length(s);
+        if (length > result.size())
+            throw utf8::not_enough_room();
+        utf8::internal::utf32to8_unchecked(s.data(), s.data() + s.size(), result.data());
+        return length;
+    }
+#endif // #ifdef UTF_CPP_SPAN
 #endif // #ifndef UTF_CPP_NO_EXCEPTIONS
+#endif // #ifdef UTF_CPP_STRING_VIEW
+
+#ifdef UTF_CPP_CONSTEVAL
+namespace internal
+{
+    // Not constexpr, so that reaching it stops the compilation
+    inline void invalid_utf8_in_literal() {}
+} // namespace internal
+
+    /// A string literal checked to be valid UTF-8 when the program is
+    /// compiled. As a template argument, it can be converted at compile
+    /// time too: utf8::utf8to16<"..."_u8v>()
+    template <std::size_t N>
+    struct u8_literal {
+        char octets[N] {};      // with the terminating null
+
+        template <typename octet_type>
+        consteval u8_literal(const octet_type (&s)[N])
+        {
+            static_assert(sizeof(octet_type) == 1, "a UTF-8 literal is made of octets");
+            for (std::size_t i = 0; i < N; ++i)
+                octets[i] = static_cast<char>(s[i]);
+            if (utf8::find_invalid(begin(), end()) != end())
+                utf8::internal::invalid_utf8_in_literal();
+        }
+
+        constexpr const char* begin() const { return octets; }
+        constexpr const char* end() const { return octets + N - 1; }
+        constexpr const char* c_str() const { return octets; }
+        constexpr std::size_t size() const { return N - 1; }
+        constexpr operator std::string_view() const { return {octets, N - 1}; }
+    };
+
+    // The literal converted without a terminating null
+    template <u8_literal literal>
+    consteval auto utf8to16()
+    {
+        constexpr std::size_t length = [] {
+            std::size_t units = 0;
+            for (const char* it = literal.begin(); it != literal.end(); )
+                units += utf8::internal::next_unchecked(it) > 0xffff ? 2 : 1;
+            return units;
+        }();
+        std::array<char16_t, length> result {};
+        utf8::internal::utf8to16_unchecked(literal.begin(), literal.end(), result.begin());
+        return result;
+    }
+
+    template <u8_literal literal>
+    consteval auto utf8to32()
+    {
+        std::array<char32_t, utf8::nothrow::distance(literal.begin(), literal.end()).code_points> result {};
+        utf8::internal::utf8to32_unchecked(literal.begin(), literal.end(), result.begin());
+        return result;
+    }
+
+    namespace literals
+    {
+        /// "..."_u8v is a u8_literal; invalid UTF-8 in it does not compile
+        template <u8_literal literal>
+        consteval auto operator""_u8v()
+        {
+            return literal;
+        }
+    } // namespace utf8::literals
+#endif // #ifdef UTF_CPP_CONSTEVAL
 
 } // namespace utf8
 
@@ -3,6 +3,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include "../src/utf8.h"
+#include <vector>
 using namespace std;
 
 BOOST_AUTO_TEST_CASE(append)
@@ -16,4 +17,168 @@ BOOST_AUTO_TEST_CASE(append)
 	BOOST_CHECK (s.length() == 3 && s[0] == '\xe6' && s[1] == '\x97' && s[2] == '\xa5');
 }
 
+BOOST_AUTO_TEST_CASE(find_invalid)
+{
+	const char utf_invalid[] = "\xe6\x97\xa5\xd1\x88\xfa";
+	BOOST_CHECK (utf8::find_invalid(utf_invalid, utf_invalid + 6) == utf_invalid + 5);
+	BOOST_CHECK (!utf8::is_valid(utf_invalid, utf_invalid + 6));
+	BOOST_CHECK (utf8::is_valid(utf_invalid, utf_invalid + 5));
+	const char overlong[] = "\xc0\xaf";
+	BOOST_CHECK (utf8::find_invalid(overlong, overlong + 2) == overlong);
+	const char surrogate[] = "a\xed\xa0\x80";
+	BOOST_CHECK (utf8::find_invalid(surrogate, surrogate + 4) == surrogate + 1);
+	const char incomplete[] = "a\xe6\x97";
+	BOOST_CHECK (utf8::find_invalid(incomplete, incomplete + 3) == incomplete + 1);
+}
+
+BOOST_AUTO_TEST_CASE(next_code_point)
+{
+	const char twochars[] = "\xe6\x97\xa5\xd1\x88";
+	const char* w = twochars;
+	BOOST_CHECK (utf8::next(w, twochars + 5) == 0x65e5);
+	BOOST_CHECK (utf8::next(w, twochars + 5) == 0x0448);
+	BOOST_CHECK (w == twochars + 5);
+	const char* incomplete = twochars;
+	BOOST_CHECK_THROW (utf8::next(incomplete, twochars + 2), utf8::not_enough_room);
+	BOOST_CHECK (incomplete == twochars);
+	const char surrogate[] = "\xed\xa0\x80";
+	const char* s = surrogate;
+	BOOST_CHECK_THROW (utf8::next(s, surrogate + 3), utf8::invalid_code_point);
+	const char* lead = twochars + 1;
+	BOOST_CHECK_THROW (utf8::next(lead, twochars + 5), utf8::invalid_utf8);
+	BOOST_CHECK (utf8::distance(twochars, twochars + 5) == 2);
+}
+
+BOOST_AUTO_TEST_CASE(conversions)
+{
+	const char utf8_with_surrogates[] = "\xe6\x97\xa5\xd1\x88\xf0\x9d\x84\x9e";
+	vector<char16_t> utf16result;
+	utf8::utf8to16(utf8_with_surrogates, utf8_with_surrogates + 9, back_inserter(utf16result));
+	BOOST_CHECK (utf16result.size() == 4 && utf16result[2] == 0xd834 && utf16result[3] == 0xdd1e);
+	BOOST_CHECK (utf8::utf8to16_length(utf8_with_surrogates, utf8_with_surrogates + 9) == 4);
+	string utf8result;
+	utf8::utf16to8(utf16result.begin(), utf16result.end(), back_inserter(utf8result));
+	BOOST_CHECK (utf8result == utf8_with_surrogates);
+	BOOST_CHECK (utf8::utf16to8_length(utf16result.begin(), utf16result.end()) == 9);
+	const char16_t lone[] = {0x41, 0xdc00};
+	BOOST_CHECK_THROW (utf8::utf16to8(lone, lone + 2, back_inserter(utf8result)), utf8::invalid_utf16);
+
+	vector<char32_t> utf32result;
+	utf8::utf8to32(utf8_with_surrogates, utf8_with_surrogates + 9, back_inserter(utf32result));
+	BOOST_CHECK (utf32result.size() == 3 && utf32result[2] == 0x1d11e);
+	char octets[9];
+	BOOST_CHECK (utf8::utf32to8(utf32result.begin(), utf32result.end(), octets) == octets + 9);
+	BOOST_CHECK (string(octets, 9) == utf8_with_surrogates);
+	const char32_t invalid[] = {0x41, 0x110000};
+	BOOST_CHECK_THROW (utf8::utf32to8_length(invalid, invalid + 2), utf8::invalid_code_point);
+}
+
+BOOST_AUTO_TEST_CASE(nothrow_api)
+{
+	const char utf_invalid[] = "\xe6\x97\xa5\xd1\x88\xfa\xd1\x88\xe6\x97";
+	char32_t cp = 0;
+	const char* it = utf_invalid;
+	BOOST_CHECK (utf8::nothrow::next(it, utf_invalid + 10, cp) == utf8::utf_error::UTF8_OK && cp == 0x65e5);
+	BOOST_CHECK (utf8::nothrow::advance(it, 2, utf_invalid + 10) == utf8::utf_error::INVALID_LEAD);
+	BOOST_CHECK (it == utf_invalid + 5);
+	BOOST_CHECK (utf8::nothrow::prior(it, utf_invalid, cp) == utf8::utf_error::UTF8_OK && cp == 0x0448);
+	BOOST_CHECK (it == utf_invalid + 3);
+	it = utf_invalid + 1;
+	BOOST_CHECK (utf8::nothrow::prior(it, utf_invalid, cp) == utf8::utf_error::INVALID_LEAD && it == utf_invalid + 1);
+	it = utf_invalid;
+	BOOST_CHECK (utf8::nothrow::prior(it, utf_invalid, cp) == utf8::utf_error::NOT_ENOUGH_ROOM && it == utf_invalid);
+	const char trails[] = "\x88\x88";
+	it = trails + 2;
+	BOOST_CHECK (utf8::nothrow::prior(it, trails, cp) == utf8::utf_error::INVALID_LEAD && it == trails + 2);
+
+	utf8::nothrow::range_result<const char*> counted = utf8::nothrow::distance(utf_invalid, utf_invalid + 10);
+	BOOST_CHECK (counted.error == utf8::utf_error::INVALID_LEAD && counted.in == utf_invalid + 5);
+	BOOST_CHECK (counted.offset == 5 && counted.code_points == 2);
+	counted = utf8::nothrow::find_invalid(utf_invalid + 6, utf_invalid + 10);
+	BOOST_CHECK (counted.error == utf8::utf_error::NOT_ENOUGH_ROOM && counted.offset == 2 && counted.code_points == 1);
+
+	string fixed;
+	utf8::nothrow::conversion_result<const char*, back_insert_iterator<string> > replaced =
+		utf8::nothrow::replace_invalid(utf_invalid, utf_invalid + 10, back_inserter(fixed));
+	BOOST_CHECK (replaced.error == utf8::utf_error::INVALID_LEAD && replaced.offset == 5 && replaced.in == utf_invalid + 10);
+	BOOST_CHECK (fixed == "\xe6\x97\xa5\xd1\x88\xef\xbf\xbd\xd1\x88\xef\xbf\xbd");
+
+	char16_t utf16[8];
+	utf8::nothrow::conversion_result<const char*, char16_t*> to16 = utf8::nothrow::utf8to16(utf_invalid, utf_invalid + 10, utf16);
+	BOOST_CHECK (to16.error == utf8::utf_error::INVALID_LEAD && to16.offset == 5 && to16.out == utf16 + 2);
+	char32_t utf32[8];
+	utf8::nothrow::conversion_result<const char*, char32_t*> to32 = utf8::nothrow::utf8to32(utf_invalid, utf_invalid + 5, utf32);
+	BOOST_CHECK (to32.error == utf8::utf_error::UTF8_OK && to32.in == utf_invalid + 5 && to32.out == utf32 + 2);
 
+	const char16_t lone[] = {0x41, 0xd834, 0xdd1e, 0xd800, 0x42};
+	char octets[16];
+	utf8::nothrow::conversion_result<const char16_t*, char*> from16 = utf8::nothrow::utf16to8(lone, lone + 5, octets);
+	BOOST_CHECK (from16.error == utf8::utf_error::INCOMPLETE_SEQUENCE && from16.in == lone + 3 && from16.offset == 3);
+	BOOST_CHECK (string(octets, from16.out) == "A\xf0\x9d\x84\x9e");
+	from16 = utf8::nothrow::utf16to8(lone, lone + 4, octets);
+	BOOST_CHECK (from16.error == utf8::utf_error::NOT_ENOUGH_ROOM && from16.in == lone + 3);
+	const char32_t invalid[] = {0x41, 0xd800};
+	utf8::nothrow::conversion_result<const char32_t*, char*> from32 = utf8::nothrow::utf32to8(invalid, invalid + 2, octets);
+	BOOST_CHECK (from32.error == utf8::utf_error::INVALID_CODE_POINT && from32.offset == 1 && from32.out == octets + 1);
+}
+
+#ifdef UTF_CPP_STRING_VIEW
+BOOST_AUTO_TEST_CASE(string_views)
+{
+	const string_view utf8_with_surrogates = "\xe6\x97\xa5\xd1\x88\xf0\x9d\x84\x9e";
+	BOOST_CHECK (utf8::is_valid(utf8_with_surrogates));
+	BOOST_CHECK (utf8::find_invalid(utf8_with_surrogates) == string_view::npos);
+	BOOST_CHECK (utf8::find_invalid(string_view("\xe6\x97\xa5\xd1\x88\xfa")) == 5);
+	BOOST_CHECK (utf8::distance(utf8_with_surrogates) == 3);
+	const u16string utf16 = utf8::utf8to16(utf8_with_surrogates);
+	BOOST_CHECK (utf16 == u"\x65e5\x0448\xd834\xdd1e");
+	BOOST_CHECK (utf8::utf16to8(utf16) == utf8_with_surrogates);
+	const u32string utf32 = utf8::utf8to32(utf8_with_surrogates);
+	BOOST_CHECK (utf32 == U"\x65e5\x0448\x1d11e");
+	BOOST_CHECK (utf8::utf32to8(utf32) == utf8_with_surrogates);
+	BOOST_CHECK_THROW (utf8::utf8to16(utf8_with_surrogates.substr(0, 8)), utf8::not_enough_room);
+}
+#endif
+
+#ifdef UTF_CPP_SPAN
+BOOST_AUTO_TEST_CASE(spans)
+{
+	const string_view utf8_with_surrogates = "\xe6\x97\xa5\xd1\x88\xf0\x9d\x84\x9e";
+	char16_t utf16[4];
+	BOOST_CHECK (utf8::utf8to16(utf8_with_surrogates, utf16) == 4);
+	BOOST_CHECK (utf16[0] == 0x65e5 && utf16[3] == 0xdd1e);
+	char32_t utf32[3];
+	BOOST_CHECK (utf8::utf8to32(utf8_with_surrogates, utf32) == 3 && utf32[2] == 0x1d11e);
+	char octets[9];
+	BOOST_CHECK (utf8::utf16to8(u16string_view(utf16, 4), octets) == 9);
+	BOOST_CHECK (string_view(octets, 9) == utf8_with_surrogates);
+	BOOST_CHECK (utf8::utf32to8(u32string_view(utf32, 3), span<char>(octets, 9)) == 9);
+	BOOST_CHECK_THROW (utf8::utf8to16(utf8_with_surrogates, span<char16_t>(utf16, 3)), utf8::not_enough_room);
+}
+#endif
+
+#ifdef UTF_CPP_CONSTEVAL
+constexpr std::array<char16_t, 4> compile_time_utf16()
+{
+	std::array<char16_t, 4> utf16 {};
+	const char octets[] = "\xe6\x97\xa5\xd1\x88\xf0\x9d\x84\x9e";
+	utf8::utf8to16(octets, octets + 9, utf16.begin());
+	return utf16;
+}
+
+BOOST_AUTO_TEST_CASE(compile_time)
+{
+	using namespace utf8::literals;
+	static_assert(compile_time_utf16()[3] == 0xdd1e);
+	static_assert(utf8::find_invalid(string_view("\xe6\x97\xa5\xd1\x88\xfa")) == 5);
+
+	constexpr auto literal = "\xe6\x97\xa5\xd1\x88\xf0\x9d\x84\x9e"_u8v;
+	static_assert(literal.size() == 9);
+	constexpr auto utf16 = utf8::utf8to16<literal>();
+	static_assert(utf16.size() == 4 && utf16[0] == 0x65e5 && utf16[2] == 0xd834);
+	constexpr auto utf32 = utf8::utf8to32<u8"日ш">();
+	static_assert(utf32.size() == 2 && utf32[1] == 0x0448);
+	BOOST_CHECK (string_view(literal) == "\xe6\x97\xa5\xd1\x88\xf0\x9d\x84\x9e");
+	BOOST_CHECK (u16string(utf16.begin(), utf16.end()) == u"\x65e5\x0448\xd834\xdd1e");
+}
+#endif